@@ -15,57 +15,122 @@
 */
 #pragma once
 #include "traits.h"
+#include <array>
+#include <cctype>
+#include <cerrno>
+#include <charconv>
+#include <cstdlib>
 #include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <type_traits>
 
 namespace fty {
 
-template <typename T, typename VT>
-T convert(const VT& value)
-{
-    if constexpr (std::is_constructible_v<std::string, VT>) {
-        std::string string(value);
+namespace detail {
+
+    /// Parses the number at the beginning of the string with from_chars, accepts the plus sign as std::stoi does.
+    /// Negative values of unsigned types are out of range.
+    template <typename T>
+    std::from_chars_result fromChars(std::string_view str, T& value)
+    {
+        const char* begin = str.data();
+        const char* end   = str.data() + str.size();
+        if (str.size() > 1 && str[0] == '+' && str[1] != '-') {
+            ++begin;
+        }
+        if constexpr (std::is_unsigned_v<T>) {
+            if (begin != end && *begin == '-') {
+                return {begin, std::errc::result_out_of_range};
+            }
+        }
+
+#if __cpp_lib_to_chars >= 201611L
+        return std::from_chars(begin, end, value);
+#else
+        if constexpr (std::is_floating_point_v<T>) {
+            // Floating point from_chars is missing in older libraries, strtod needs a null terminated string
+            std::string copy(begin, end);
+            if (copy.empty() || std::isspace(static_cast<unsigned char>(copy[0]))) {
+                return {begin, std::errc::invalid_argument};
+            }
+            char* last = nullptr;
+            errno      = 0;
+            if constexpr (std::is_same_v<T, float>) {
+                value = std::strtof(copy.c_str(), &last);
+            } else if constexpr (std::is_same_v<T, double>) {
+                value = std::strtod(copy.c_str(), &last);
+            } else {
+                value = std::strtold(copy.c_str(), &last);
+            }
+            if (last == copy.c_str()) {
+                return {begin, std::errc::invalid_argument};
+            }
+            return {begin + (last - copy.c_str()), errno == ERANGE ? std::errc::result_out_of_range : std::errc()};
+        } else {
+            return std::from_chars(begin, end, value);
+        }
+#endif
+    }
+
+    /// Converts the string to the value, see convert()
+    template <typename T>
+    T fromString(std::string_view string)
+    {
         if (string.empty()) {
             return T{};
         }
         if constexpr (std::is_same_v<T, std::string>) {
-            return string;
+            return std::string(string);
         } else if constexpr (std::is_same_v<T, bool>) {
             return string == "1" || string == "true";
-        } else if constexpr (std::is_same_v<T, float>) {
-            return std::stof(string);
-        } else if constexpr (std::is_same_v<T, double>) {
-            return std::stod(string);
-        } else if constexpr (std::is_same_v<T, int8_t>) {
-            return int8_t(std::stoi(string));
-        } else if constexpr (std::is_same_v<T, uint8_t>) {
-            return uint8_t(std::stoul(string));
-        } else if constexpr (std::is_same_v<T, int16_t>) {
-            return int16_t(std::stoi(string));
-        } else if constexpr (std::is_same_v<T, uint16_t>) {
-            return uint16_t(std::stoul(string));
-        } else if constexpr (std::is_same_v<T, int32_t>) {
-            return int32_t(std::stoi(string));
-        } else if constexpr (std::is_same_v<T, uint32_t>) {
-            return uint32_t(std::stoul(string));
-        } else if constexpr (std::is_same_v<T, int64_t>) {
-            return std::stoll(string);
-        } else if constexpr (std::is_same_v<T, uint64_t>) {
-            return std::stoull(string);
-        } else if constexpr (std::is_same_v<T, unsigned char>) {
-            return static_cast<unsigned char>(string[0]);
+        } else if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>) {
+            // Same rules as std::stoi: leading spaces are skipped, the rest after the number is ignored
+            size_t pos = 0;
+            while (pos < string.size() && std::isspace(static_cast<unsigned char>(string[pos]))) {
+                ++pos;
+            }
+
+            T    result{};
+            auto ret = fromChars(string.substr(pos), result);
+            if (ret.ec == std::errc::result_out_of_range) {
+                throw std::out_of_range("convert: value is out of range");
+            }
+            if (ret.ec != std::errc()) {
+                throw std::invalid_argument("convert: not a number");
+            }
+            return result;
         } else {
             static_assert(fty::always_false<T>, "Unsupported type");
         }
+    }
+
+} // namespace detail
+
+template <typename T, typename VT>
+T convert(const VT& value)
+{
+    if constexpr (std::is_convertible_v<const VT&, std::string_view>) {
+        return detail::fromString<T>(value);
+    } else if constexpr (std::is_constructible_v<std::string, VT>) {
+        // Types converting to std::string only (fty::Translate...) are not viewed, the string is built first
+        return detail::fromString<T>(std::string(value));
     } else if constexpr (std::is_same_v<T, std::string>) {
         if constexpr (std::is_integral_v<VT> && !std::is_same_v<bool, VT>) {
             return std::to_string(value);
         } else if constexpr (std::is_floating_point_v<VT>) {
+#if __cpp_lib_to_chars >= 201611L
+            // Shortest text which reads back to the same value
+            std::array<char, 64> buffer;
+            auto                 ret = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+            return std::string(buffer.data(), ret.ptr);
+#else
             // In case of floats std::to_string gives not pretty results. So, just use stringstream here.
             std::stringstream ss;
             ss << value;
             return ss.str();
+#endif
         } else if constexpr (std::is_same_v<bool, VT>) {
             return value ? "true" : "false";
         } else {
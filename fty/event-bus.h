@@ -0,0 +1,308 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#pragma once
+#include "fty/event.h"
+#include <algorithm>
+#include <array>
+#include <fnmatch.h>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace fty {
+
+// ===========================================================================================================
+
+/// Typed publish/subscribe bus built on fty::Event.
+/// Topic names are resolved once to integer handles. Publishing by handle takes no bus lock and does no string
+/// processing, so it costs O(subscribers) plus the event snapshot load (see Event). Wildcard subscriptions use
+/// glob patterns (see fnmatch(3)) and are connected to matching topics when the topic or the subscription is
+/// created.
+/// Typical usage is:
+///     EventBus<double> bus;
+///     auto topic = bus.topic("metrics/ups-1/load");
+///     auto connection = bus.subscribe("metrics/*/load", slot);
+///     bus.publish(topic, 42.);
+template <typename... Args>
+class EventBus
+{
+public:
+    using Topic = uint32_t;
+
+    static constexpr Topic InvalidTopic = Topic(-1);
+
+public:
+    EventBus();
+    ~EventBus();
+
+    EventBus(const EventBus&) = delete;
+    EventBus& operator=(const EventBus&) = delete;
+
+    /// Returns the handle of the topic, creates the topic if it does not exist
+    Topic topic(const std::string& name);
+
+    /// Returns the name of the topic
+    const std::string& name(Topic topic) const;
+
+    /// Returns the number of topics
+    size_t size() const;
+
+    /// Returns the number of wildcard subscriptions kept by the bus. Ended ones are dropped on the next
+    /// subscription or topic creation.
+    size_t wildcards() const;
+
+    /// Subscribes the slot to the topic
+    Connection subscribe(Topic topic, Slot<Args...>& slot);
+
+    /// Subscribes the slot to every existing and future topic which matches the glob pattern.
+    /// Subscription ends when the slot is destroyed or the returned connection is disconnected, which
+    /// disconnects the slot from all the matched topics.
+    Connection subscribe(const std::string& pattern, Slot<Args...>& slot);
+
+    /// Publishes to the topic, see Event::operator()
+    void publish(Topic topic, Args&&... args) const;
+
+    /// Returns the event of the topic, could be used to emit lvalues or to wait for the topic
+    Event<Args...>& event(Topic topic);
+
+private:
+    struct TopicNode
+    {
+        std::string    name;
+        Event<Args...> event;
+    };
+
+    static constexpr size_t ChunkBits = 10;
+    static constexpr size_t ChunkSize = size_t(1) << ChunkBits;
+    static constexpr size_t MaxChunks = 1024;
+
+    using Chunk   = std::array<std::unique_ptr<TopicNode>, ChunkSize>;
+    using SlotPtr = std::shared_ptr<typename Slot<Args...>::Impl>;
+
+    /// Wildcard subscription, owns the connections made to the matched topics
+    struct Wildcard : public details::ConnectionLink
+    {
+        Wildcard(const std::string& glob, const SlotPtr& impl);
+        bool isAlive() const override;
+        void disconnect() override;
+        void add(Connection&& connection);
+
+        std::string             pattern;
+        SlotPtr                 slot;
+        std::mutex              mutex;
+        std::vector<Connection> connections;
+    };
+    using WildcardPtr = std::shared_ptr<Wildcard>;
+
+    TopicNode* node(Topic topic) const;
+    void       connectWildcards(TopicNode& node);
+    void       removeEndedWildcards();
+
+private:
+    // Topics are never removed and chunks are never reallocated, so a handle below m_count always points to
+    // the same node. Writers are serialized by m_mutex.
+    std::array<std::atomic<Chunk*>, MaxChunks> m_chunks;
+    std::atomic<Topic>                         m_count = 0;
+    mutable std::mutex                         m_mutex;
+    std::unordered_map<std::string, Topic>     m_names;
+    std::vector<WildcardPtr>                   m_wildcards;
+};
+
+// ===========================================================================================================
+
+template <typename... Args>
+EventBus<Args...>::EventBus()
+{
+    for (auto& it : m_chunks) {
+        it.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+template <typename... Args>
+EventBus<Args...>::~EventBus()
+{
+    for (auto& it : m_chunks) {
+        delete it.load();
+    }
+}
+
+template <typename... Args>
+typename EventBus<Args...>::Topic EventBus<Args...>::topic(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_names.find(name); it != m_names.end()) {
+        return it->second;
+    }
+
+    Topic id = m_count.load(std::memory_order_relaxed);
+    if (id >= ChunkSize * MaxChunks) {
+        return InvalidTopic;
+    }
+
+    Chunk* chunk = m_chunks[id >> ChunkBits].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new Chunk;
+        m_chunks[id >> ChunkBits].store(chunk, std::memory_order_relaxed);
+    }
+
+    auto& node = (*chunk)[id & (ChunkSize - 1)];
+    node.reset(new TopicNode{name, {}});
+    connectWildcards(*node);
+
+    m_names.emplace(name, id);
+    m_count.store(id + 1, std::memory_order_release);
+    return id;
+}
+
+template <typename... Args>
+const std::string& EventBus<Args...>::name(Topic topic) const
+{
+    static const std::string empty;
+    if (auto found = node(topic)) {
+        return found->name;
+    }
+    return empty;
+}
+
+template <typename... Args>
+size_t EventBus<Args...>::size() const
+{
+    return m_count.load(std::memory_order_acquire);
+}
+
+template <typename... Args>
+size_t EventBus<Args...>::wildcards() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_wildcards.size();
+}
+
+template <typename... Args>
+Connection EventBus<Args...>::subscribe(Topic topic, Slot<Args...>& slot)
+{
+    if (auto found = node(topic)) {
+        return found->event.connect(slot);
+    }
+    return {};
+}
+
+template <typename... Args>
+Connection EventBus<Args...>::subscribe(const std::string& pattern, Slot<Args...>& slot)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    removeEndedWildcards();
+
+    auto wildcard = std::make_shared<Wildcard>(pattern, slot.m_impl);
+
+    Topic count = m_count.load(std::memory_order_relaxed);
+    for (Topic id = 0; id < count; ++id) {
+        auto found = node(id);
+        if (fnmatch(pattern.c_str(), found->name.c_str(), 0) == 0) {
+            wildcard->add(found->event.connect(slot));
+        }
+    }
+
+    m_wildcards.push_back(wildcard);
+    return Connection(wildcard);
+}
+
+template <typename... Args>
+void EventBus<Args...>::publish(Topic topic, Args&&... args) const
+{
+    if (auto found = node(topic)) {
+        found->event(std::forward<Args>(args)...);
+    }
+}
+
+template <typename... Args>
+Event<Args...>& EventBus<Args...>::event(Topic topic)
+{
+    auto found = node(topic);
+    assert(found && "Invalid topic");
+    return found->event;
+}
+
+template <typename... Args>
+typename EventBus<Args...>::TopicNode* EventBus<Args...>::node(Topic topic) const
+{
+    if (topic >= m_count.load(std::memory_order_acquire)) {
+        return nullptr;
+    }
+    return (*m_chunks[topic >> ChunkBits].load(std::memory_order_relaxed))[topic & (ChunkSize - 1)].get();
+}
+
+template <typename... Args>
+void EventBus<Args...>::connectWildcards(TopicNode& node)
+{
+    removeEndedWildcards();
+    for (const auto& it : m_wildcards) {
+        if (fnmatch(it->pattern.c_str(), node.name.c_str(), 0) == 0) {
+            it->add(node.event.connect(it->slot));
+        }
+    }
+}
+
+template <typename... Args>
+void EventBus<Args...>::removeEndedWildcards()
+{
+    // Disconnected subscriptions and the ones of destroyed slots, so they do not pile up with a fixed set of topics
+    auto ended = std::remove_if(m_wildcards.begin(), m_wildcards.end(), [](const WildcardPtr& it) {
+        return !it->isAlive();
+    });
+    m_wildcards.erase(ended, m_wildcards.end());
+}
+
+// ===========================================================================================================
+
+template <typename... Args>
+EventBus<Args...>::Wildcard::Wildcard(const std::string& glob, const SlotPtr& impl)
+    : pattern(glob)
+    , slot(impl)
+{
+}
+
+template <typename... Args>
+bool EventBus<Args...>::Wildcard::isAlive() const
+{
+    return connected && slot->isAlive();
+}
+
+template <typename... Args>
+void EventBus<Args...>::Wildcard::disconnect()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    connected = false;
+    for (auto& it : connections) {
+        it.disconnect();
+    }
+    connections.clear();
+}
+
+template <typename... Args>
+void EventBus<Args...>::Wildcard::add(Connection&& connection)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!connected) {
+        // Disconnected while the topic was being connected
+        connection.disconnect();
+        return;
+    }
+    connections.push_back(std::move(connection));
+}
+
+// ===========================================================================================================
+
+} // namespace fty
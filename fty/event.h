@@ -14,13 +14,26 @@
     ========================================================================
 */
 #pragma once
-#include <condition_variable>
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <climits>
+#include <cstdint>
 #include <functional>
 #include <iostream>
+#include <iterator>
+#include <linux/futex.h>
 #include <memory>
 #include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <sys/syscall.h>
+#include <unistd.h>
 #include <vector>
 #include <fty/expected.h>
+#include <fty/histogram.h>
 
 namespace fty {
 
@@ -29,43 +42,422 @@ namespace fty {
 template <typename...>
 class Event;
 
+template <typename...>
+class EventBus;
+
+/// Event statistics, collected only if built with FTY_EVENT_PROFILING defined
+struct EventStatistics
+{
+    /// Call time of one connected slot, only calls made by this event are counted. For queued slots it is the
+    /// execution time in the executor.
+    struct Callback
+    {
+        std::string         name;
+        Histogram::Snapshot calls;
+    };
+
+    std::string name;
+    /// Duration of the whole emit, count is the number of emits
+    Histogram::Snapshot fanOut;
+    /// Currently connected slots
+    std::vector<Callback> slots;
+};
+
+/// Executor of the queued slots: runs given job somewhere else (thread pool, event loop...)
+using Executor = std::function<void(std::function<void()>)>;
+
+/// Slot call policy. Slots are Serialized by default, thread safe handlers could opt in to Concurrent calls and
+/// avoid the mutex.
+enum class SlotPolicy
+{
+    Serialized, //! Calls of the slot are serialized with a mutex
+    Concurrent, //! Slot could be called from several threads at the same time
+};
+
+namespace details {
+    /// Mutex which does nothing, used by not serialized slots
+    struct NoMutex
+    {
+        void lock()
+        {
+        }
+        void unlock()
+        {
+        }
+    };
+
+    /// Connection state shared between event and connection handles
+    class ConnectionLink
+    {
+    public:
+        virtual ~ConnectionLink() = default;
+        virtual bool isAlive() const = 0;
+        virtual void disconnect()
+        {
+            connected = false;
+        }
+
+        std::atomic<bool> connected = true;
+    };
+
+    /// Blocks while @ref value is equal to @ref expected, could wake up spuriously
+    inline void futexWait(std::atomic<uint32_t>& value, uint32_t expected, const std::chrono::nanoseconds* timeout)
+    {
+        static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "Atomic is not usable as futex");
+
+        timespec ts;
+        if (timeout) {
+            ts.tv_sec  = time_t(timeout->count() / 1000000000);
+            ts.tv_nsec = long(timeout->count() % 1000000000);
+        }
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAIT_PRIVATE, expected, timeout ? &ts : nullptr, nullptr, 0);
+    }
+
+    /// Wakes up all threads blocked on @ref value
+    inline void futexWakeAll(std::atomic<uint32_t>& value)
+    {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&value), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+    }
+
+    /// Epoch based reclamation of the state read by emitters. Emitters read inside a Guard without any lock and
+    /// without touching a shared reference count, writers retire what they unlinked and it is destroyed once no
+    /// guard which could still see it is active. Every thread announces its epoch in its own cache line, so
+    /// guards of different threads do not contend.
+    class Epoch
+    {
+    public:
+        /// Protects everything read while it is alive, guards could be nested
+        class Guard
+        {
+        public:
+            Guard();
+            ~Guard();
+
+            Guard(const Guard&) = delete;
+            Guard& operator=(const Guard&) = delete;
+        };
+
+        /// Calls the deleter once no guard started before this call is active
+        static void retire(std::function<void()> deleter);
+
+        /// Calls the deleters which became safe to call, does nothing if other thread is doing it
+        static void reclaim();
+
+    private:
+        struct alignas(64) Reader
+        {
+            // Epoch seen when the outermost guard started, zero if the thread is not in a guard
+            std::atomic<uint64_t> epoch = 0;
+            std::atomic<bool>     used  = true;
+            Reader*               next  = nullptr;
+        };
+
+        struct Retired
+        {
+            uint64_t              epoch;
+            std::function<void()> deleter;
+        };
+
+        struct Domain
+        {
+            std::atomic<uint64_t> epoch   = 1;
+            std::atomic<Reader*>  readers = nullptr;
+            std::atomic<size_t>   pending = 0;
+            std::mutex            mutex;
+            std::vector<Retired>  retired;
+        };
+
+        struct Local
+        {
+            ~Local();
+
+            Reader*  reader = nullptr;
+            uint32_t depth  = 0;
+        };
+
+        static Domain& domain();
+        static Local&  local();
+        static Reader* acquire();
+    };
+
+    template <typename T>
+    constexpr bool isModifiableRef = std::is_lvalue_reference_v<T> && !std::is_const_v<std::remove_reference_t<T>>;
+
+    /// Argument type used when the same argument is passed to several slots
+    template <typename T>
+    using Cref = std::conditional_t<std::is_reference_v<T>, T, const T&>;
+
+    /// Argument type given to a slot which takes ownership of a shared argument: own copy of the value
+    template <typename T>
+    using Owned = std::conditional_t<std::is_reference_v<T>, T, std::decay_t<T>>;
+
+    template <typename T, typename U>
+    Owned<T> owned(U&& arg)
+    {
+        return std::forward<U>(arg);
+    }
+
+    /// Arguments could be queued if they are copyable and not modified by the slot
+    template <typename... Args>
+    constexpr bool isQueueable = (std::is_copy_constructible_v<std::decay_t<Args>> && ...) && (!isModifiableRef<Args> && ...);
+
+    // =======================================================================================================
+
+    inline Epoch::Guard::Guard()
+    {
+        Local& self = local();
+        if (self.depth++ == 0) {
+            if (!self.reader) {
+                self.reader = acquire();
+            }
+            self.reader->epoch.store(domain().epoch.load(std::memory_order_acquire), std::memory_order_release);
+            // Pairs with the fence in reclaim(): either the guard is seen there, or it sees what was unlinked
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+        }
+    }
+
+    inline Epoch::Guard::~Guard()
+    {
+        Local& self = local();
+        if (--self.depth == 0) {
+            self.reader->epoch.store(0, std::memory_order_release);
+            if (domain().pending.load(std::memory_order_relaxed)) {
+                reclaim();
+            }
+        }
+    }
+
+    inline void Epoch::retire(std::function<void()> deleter)
+    {
+        Domain& dom = domain();
+        {
+            std::lock_guard<std::mutex> lock(dom.mutex);
+            // Guards started after the increment cannot see what was unlinked before the call
+            dom.retired.push_back({dom.epoch.fetch_add(1, std::memory_order_acq_rel), std::move(deleter)});
+            dom.pending.store(dom.retired.size(), std::memory_order_relaxed);
+        }
+        reclaim();
+    }
+
+    inline void Epoch::reclaim()
+    {
+        Domain&              dom = domain();
+        std::vector<Retired> ready;
+        {
+            std::unique_lock<std::mutex> lock(dom.mutex, std::try_to_lock);
+            if (!lock || dom.retired.empty()) {
+                return;
+            }
+
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            uint64_t oldest = UINT64_MAX;
+            for (Reader* it = dom.readers.load(std::memory_order_acquire); it; it = it->next) {
+                if (uint64_t epoch = it->epoch.load(std::memory_order_acquire)) {
+                    oldest = std::min(oldest, epoch);
+                }
+            }
+
+            auto safe = std::stable_partition(dom.retired.begin(), dom.retired.end(), [&](const Retired& it) {
+                return it.epoch >= oldest;
+            });
+            std::move(safe, dom.retired.end(), std::back_inserter(ready));
+            dom.retired.erase(safe, dom.retired.end());
+            dom.pending.store(dom.retired.size(), std::memory_order_relaxed);
+        }
+
+        // Outside of the lock, deleters could retire more
+        for (auto& it : ready) {
+            it.deleter();
+        }
+    }
+
+    inline Epoch::Domain& Epoch::domain()
+    {
+        // Never destroyed, threads could still use it at exit
+        static Domain* dom = new Domain;
+        return *dom;
+    }
+
+    inline Epoch::Local& Epoch::local()
+    {
+        static thread_local Local self;
+        return self;
+    }
+
+    inline Epoch::Reader* Epoch::acquire()
+    {
+        // Readers are never freed, the ones of finished threads are reused
+        Domain& dom = domain();
+        for (Reader* it = dom.readers.load(std::memory_order_acquire); it; it = it->next) {
+            bool expected = false;
+            if (!it->used.load(std::memory_order_relaxed) && it->used.compare_exchange_strong(expected, true)) {
+                return it;
+            }
+        }
+
+        auto reader  = new Reader;
+        reader->next = dom.readers.load(std::memory_order_relaxed);
+        while (!dom.readers.compare_exchange_weak(reader->next, reader, std::memory_order_release, std::memory_order_relaxed)) {
+        }
+        return reader;
+    }
+
+    inline Epoch::Local::~Local()
+    {
+        if (reader) {
+            reader->used.store(false, std::memory_order_release);
+        }
+    }
+} // namespace details
+
+// ===========================================================================================================
+
+/// Handle of the connection between an event and a slot.
+/// Disconnect is O(1): connection is marked as dead and dropped by the event on the next emit or connect.
+class Connection
+{
+public:
+    Connection() = default;
+
+    /// Disconnects the slot from the event
+    void disconnect();
+
+    /// Returns true if connection is still alive
+    bool isConnected() const;
+
+private:
+    template <typename...>
+    friend class Event;
+    template <typename...>
+    friend class EventBus;
+
+    Connection(std::weak_ptr<details::ConnectionLink> link);
+
+private:
+    std::weak_ptr<details::ConnectionLink> m_link;
+};
+
+/// Connection which disconnects the slot when goes out of scope
+class ScopedConnection : public Connection
+{
+public:
+    ScopedConnection() = default;
+    ScopedConnection(Connection&& connection);
+    ScopedConnection(ScopedConnection&& other) = default;
+    ScopedConnection& operator=(ScopedConnection&& other);
+    ~ScopedConnection();
+
+    ScopedConnection(const ScopedConnection&) = delete;
+    ScopedConnection& operator=(const ScopedConnection&) = delete;
+
+    /// Releases the connection, it will not be disconnected on destruction
+    Connection release();
+};
+
 // ===========================================================================================================
 
 template <typename... Args>
 class Slot
 {
 public:
+    /// Slot state shared between slot copies and referenced by events
     class Impl
     {
     public:
-        template <typename Func, typename Cls>
-        Impl(Func&& func, Cls* cls);
-        template <typename Func>
-        Impl(Func&& func);
+        virtual ~Impl() = default;
+
+        /// Calls the slot, slot could take ownership of the arguments
+        virtual void call(Args&&... args) const = 0;
+        /// Calls the slot, arguments are shared with other slots
+        virtual void callRef(details::Cref<Args>... args) const = 0;
 
-        void call(Args&&... args) const;
+        /// Returns false once the last Slot copy is destroyed, the slot is not called anymore
+        bool isAlive() const;
+
+    protected:
+        Impl(Executor executor, bool shared);
+
+        /// Destroys the callable, called when no emitter could be calling it
+        virtual void release() = 0;
 
     private:
-        std::function<void(Args...)> m_function;
-        mutable std::mutex           m_mutex;
+        friend class Event<Args...>;
+        friend class Slot<Args...>;
+        Executor              m_executor;
+        // False if the slot takes ownership of not copyable arguments, it could not share them with other slots
+        bool                  m_shared;
+        // Slot copies, events keep the state alive but do not own the slot
+        std::atomic<uint32_t> m_owners = 1;
+#ifdef FTY_EVENT_PROFILING
+        std::string m_name;
+#endif
     };
 
 public:
     template <typename Func, typename Cls>
-    Slot(Func&& func, Cls* cls);
+    Slot(Func&& func, Cls* cls, SlotPolicy policy = SlotPolicy::Serialized);
+    template <typename Func>
+    Slot(Func&& func, SlotPolicy policy = SlotPolicy::Serialized);
+
+    /// Creates queued slot: emit only posts the call to @ref executor and does not wait for it.
+    /// Arguments are copied, the call is dropped if the slot is destroyed before execution.
+    template <typename Func, typename Cls>
+    Slot(Func&& func, Cls* cls, Executor executor, SlotPolicy policy = SlotPolicy::Serialized);
+    /// Creates queued slot: emit only posts the call to @ref executor and does not wait for it.
+    /// Arguments are copied, the call is dropped if the slot is destroyed before execution.
     template <typename Func>
-    Slot(Func&& func);
+    Slot(Func&& func, Executor executor, SlotPolicy policy = SlotPolicy::Serialized);
     Slot(Slot&&) = default;
-    Slot(const Slot&) = default;
+    Slot(const Slot&);
     ~Slot();
 
-    void connect(Event<Args...>& signal);
+    Connection connect(Event<Args...>& signal);
+
+    /// Sets the name shown in event statistics, should be set before connecting. Does nothing if profiling is
+    /// disabled.
+    void setName(const std::string& name);
+
+private:
+    // Callable is stored inline, in the same allocation as shared pointer control block
+    template <typename Func, typename Mutex>
+    class Callable;
+
+    template <typename Func, typename Cls>
+    static auto bind(Func&& func, Cls* cls);
+
+    template <typename Func>
+    static std::shared_ptr<Impl> create(Func&& func, Executor&& executor, SlotPolicy policy);
 
 private:
     friend class Event<Args...>;
+    friend class EventBus<Args...>;
     std::shared_ptr<Impl> m_impl;
 };
 
+template <typename... Args>
+template <typename Func, typename Mutex>
+class Slot<Args...>::Callable final : public Slot<Args...>::Impl
+{
+public:
+    /// Slot could be called with the arguments shared with other slots, directly or with own copies of them
+    static constexpr bool byRef  = std::is_invocable_v<Func&, details::Cref<Args>...>;
+    static constexpr bool byCopy = (std::is_constructible_v<details::Owned<Args>, details::Cref<Args>> && ...) &&
+                                   std::is_invocable_v<Func&, details::Owned<Args>...>;
+
+    template <typename F>
+    Callable(F&& func, Executor&& executor);
+
+    void call(Args&&... args) const override;
+    void callRef(details::Cref<Args>... args) const override;
+
+protected:
+    void release() override;
+
+private:
+    mutable std::optional<Func> m_function;
+    mutable Mutex               m_mutex;
+};
+
 // ===========================================================================================================
 
 template <typename... Args>
@@ -76,23 +468,48 @@ public:
 
     Event() = default;
 
+    /// Creates named event, name is used in statistics only
+    explicit Event(const std::string& name);
+
     Event(const Event&) = delete;
     Event& operator=(const Event&) = delete;
 
     Event(Event&& other)
-        : m_connections(std::move(other.m_connections))
+        : m_connections(other.m_connections.exchange(nullptr))
+        , m_exclusive(std::move(other.m_exclusive))
+#ifdef FTY_EVENT_PROFILING
+        , m_name(std::move(other.m_name))
+#endif
     {
     }
 
     Event& operator=(Event&& other)
     {
-        std::swap(m_connections, other.m_connections);
+        auto connections = m_connections.load();
+        m_connections.store(other.m_connections.load());
+        other.m_connections.store(connections);
+        std::swap(m_exclusive, other.m_exclusive);
+        return *this;
     }
 
+    /// Emits the event. Every slot but the last one gets the arguments by const reference, the last one could
+    /// take ownership of them, so the payload is never copied by the event itself. Slots taking the arguments
+    /// by value or by rvalue reference get their own copies, except the last one.
     void operator()(Args&&... args) const;
 
-    void connect(Slot<Args...>& slot);
+    /// Emits the event passing the arguments by const reference to every slot, caller keeps ownership.
+    /// Throws std::logic_error for a slot taking ownership of not copyable arguments.
+    void emit(details::Cref<Args>... args) const;
+
+    /// Connects the slot. A slot taking ownership of not copyable arguments (std::unique_ptr by value...) must
+    /// be the only slot of the event, std::logic_error is thrown otherwise.
+    /// Connections of destroyed slots and disconnected ones are dropped by the next connect().
+    /// Note: connect allocates the connection state shared with the returned Connection, and the connection
+    /// storage is reallocated when it is full or holds dead connections. Disconnect does not allocate.
+    Connection connect(Slot<Args...>& slot);
 
+    /// Waits for the event. Returns immediately if the event was emitted since the previous wait, every thread
+    /// waiting at the moment of emit is woken up once.
     void wait();
 
     Expected<void> wait(int msecTimeout);
@@ -100,63 +517,359 @@ public:
     template <typename Rep, typename Period>
     Expected<void> wait(const std::chrono::duration<Rep, Period>& timeout);
 
+    /// Returns emit and slots call statistics. Empty if built without FTY_EVENT_PROFILING.
+    EventStatistics statistics() const;
+
+private:
+    friend class EventBus<Args...>;
+
+    using SlotImplPtr = std::shared_ptr<typename Slot<Args...>::Impl>;
+
+    /// Keeps the slot state, not the slot: the slot is not called once its last copy is destroyed
+    struct Link : public details::ConnectionLink
+    {
+        Link(const SlotImplPtr& impl);
+        bool isAlive() const override;
+
+        SlotImplPtr slot;
+#ifdef FTY_EVENT_PROFILING
+        // Calls through this connection only, the slot could be connected to other events too
+        mutable Histogram calls;
+#endif
+    };
+    using LinkPtr = std::shared_ptr<Link>;
+
+    /// Fixed capacity block of connections. Emitters see only items below published size, so new item is
+    /// appended in place, any other change publishes new block.
+    struct Connections
+    {
+        explicit Connections(size_t capacity);
+
+        std::vector<LinkPtr> items;
+        std::atomic<size_t>  size = 0;
+    };
+
+    template <typename Func>
+    const LinkPtr* visit(Func&& func) const;
+
+    Connection   connect(const SlotImplPtr& slot);
+    Connections* rebuild(Connections* current, size_t reserve);
+    void         callRef(const LinkPtr& link, details::Cref<Args>... args) const;
+    void         callMove(const LinkPtr& link, Args&&... args) const;
+    void         notifyWaiters() const;
+    bool         waitFor(const std::chrono::nanoseconds* timeout);
+
+    template <typename... Params>
+    void post(const LinkPtr& link, Params&&... args) const;
+
+    template <typename Func>
+    static void profiled(const Link& link, Func&& func);
+
 private:
-    using Connections = std::vector<std::weak_ptr<typename Slot<Args...>::Impl>>;
+    // Emitters iterate over the block they loaded inside an epoch guard, without any lock or reference count,
+    // so slots can safely emit or connect to the same event. Writers are serialized by m_writeMutex and retire
+    // replaced blocks, see details::Epoch.
+    std::atomic<Connections*> m_connections = nullptr;
+    mutable std::mutex        m_writeMutex;
+    // Set by emitters which skipped a dead connection, next connect() drops them
+    mutable std::atomic<bool> m_expired = false;
+    // Connection of a slot which takes ownership of not copyable arguments, it must be the only one
+    std::weak_ptr<Link>       m_exclusive;
 
-    mutable Connections             m_connections;
-    mutable std::mutex              m_mutex;
-    mutable std::condition_variable m_cv;
-    bool                            m_stopped = false;
-    mutable bool                    m_fired   = false;
+    // Waiting is done with futex on emit generation, so there is nothing to allocate for events nobody waits
+    mutable std::atomic<uint32_t> m_generation = 0;
+    mutable std::atomic<uint32_t> m_waited     = 0;
+    mutable std::atomic<uint32_t> m_waiters    = 0;
+    std::atomic<bool>             m_stopped    = false;
+
+#ifdef FTY_EVENT_PROFILING
+    std::string       m_name;
+    mutable Histogram m_fanOut;
+#endif
 };
 
 // ===========================================================================================================
 
+template <typename... Args>
+Event<Args...>::Event([[maybe_unused]] const std::string& name)
+#ifdef FTY_EVENT_PROFILING
+    : m_name(name)
+#endif
+{
+}
+
 template <typename... Args>
 Event<Args...>::~Event()
 {
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_stopped = true;
+    m_stopped = true;
+    notifyWaiters();
+    if (auto connections = m_connections.exchange(nullptr)) {
+        details::Epoch::retire([connections]() {
+            delete connections;
+        });
     }
-    m_cv.notify_all();
 }
 
 template <typename... Args>
 void Event<Args...>::operator()(Args&&... args) const
 {
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        Connections                 toRemove;
+#ifdef FTY_EVENT_PROFILING
+    auto start = std::chrono::steady_clock::now();
+#endif
+    details::Epoch::Guard guard;
+
+    auto deliver = [&](const LinkPtr& link) {
+        callRef(link, args...);
+    };
+
+    if (auto last = visit(deliver)) {
+        callMove(*last, std::forward<Args>(args)...);
+    }
+#ifdef FTY_EVENT_PROFILING
+    m_fanOut.add(std::chrono::steady_clock::now() - start);
+#endif
+    notifyWaiters();
+}
+
+template <typename... Args>
+void Event<Args...>::emit(details::Cref<Args>... args) const
+{
+#ifdef FTY_EVENT_PROFILING
+    auto start = std::chrono::steady_clock::now();
+#endif
+    details::Epoch::Guard guard;
 
-        for (auto iter = m_connections.begin(); iter != m_connections.end();) {
-            if (auto caller = iter->lock()) {
-                caller->call(std::forward<Args>(args)...);
-                ++iter;
-            } else {
-                m_connections.erase(iter);
+    auto deliver = [&](const LinkPtr& link) {
+        callRef(link, args...);
+    };
+
+    if (auto last = visit(deliver)) {
+        deliver(*last);
+    }
+#ifdef FTY_EVENT_PROFILING
+    m_fanOut.add(std::chrono::steady_clock::now() - start);
+#endif
+    notifyWaiters();
+}
+
+template <typename... Args>
+template <typename Func>
+const typename Event<Args...>::LinkPtr* Event<Args...>::visit(Func&& func) const
+{
+    // Calls all alive slots but the last one, which is returned to the caller. Caller holds an epoch guard, so
+    // the block and the links stay valid until it returns.
+    const LinkPtr* last       = nullptr;
+    bool           hasExpired = false;
+    if (auto connections = m_connections.load(std::memory_order_acquire)) {
+        size_t size = connections->size.load(std::memory_order_acquire);
+        for (size_t i = 0; i < size; ++i) {
+            const LinkPtr& link = connections->items[i];
+            if (!link->isAlive()) {
+                hasExpired = true;
+                continue;
+            }
+            if (last) {
+                func(*last);
             }
+            last = &link;
         }
-        m_fired = true;
     }
-    m_cv.notify_all();
+
+    // Emit does not allocate, dead connections are dropped by the next connect()
+    if (hasExpired && !m_expired.load(std::memory_order_relaxed)) {
+        m_expired.store(true, std::memory_order_relaxed);
+    }
+    return last;
+}
+
+template <typename... Args>
+void Event<Args...>::callRef(const LinkPtr& link, details::Cref<Args>... args) const
+{
+    const auto& slot = link->slot;
+    if (slot->m_executor) {
+        post(link, args...);
+    } else {
+        profiled(*link, [&]() {
+            slot->callRef(args...);
+        });
+    }
+}
+
+template <typename... Args>
+void Event<Args...>::callMove(const LinkPtr& link, Args&&... args) const
+{
+    const auto& slot = link->slot;
+    if (slot->m_executor) {
+        post(link, std::forward<Args>(args)...);
+    } else {
+        profiled(*link, [&]() {
+            slot->call(std::forward<Args>(args)...);
+        });
+    }
+}
+
+template <typename... Args>
+void Event<Args...>::notifyWaiters() const
+{
+    m_generation.fetch_add(1);
+    if (m_waiters.load()) {
+        details::futexWakeAll(m_generation);
+    }
+}
+
+template <typename... Args>
+Connection Event<Args...>::connect(Slot<Args...>& slot)
+{
+    return connect(slot.m_impl);
+}
+
+template <typename... Args>
+Connection Event<Args...>::connect(const SlotImplPtr& slot)
+{
+    std::lock_guard<std::mutex> lock(m_writeMutex);
+
+    auto   connections = m_connections.load(std::memory_order_relaxed);
+    size_t size        = connections ? connections->size.load(std::memory_order_relaxed) : 0;
+
+    // Slot which takes ownership of not copyable arguments can get them only if nobody else needs them
+    if (auto exclusive = m_exclusive.lock(); exclusive && exclusive->isAlive()) {
+        throw std::logic_error("Event is connected to a slot taking ownership of its arguments, no other slot can be connected");
+    }
+    if (!slot->m_shared) {
+        for (size_t i = 0; i < size; ++i) {
+            if (connections->items[i]->isAlive()) {
+                throw std::logic_error("Slot taking ownership of not copyable arguments must be the only slot of the event");
+            }
+        }
+    }
+
+    if (!connections || size == connections->items.size() || m_expired.exchange(false, std::memory_order_relaxed)) {
+        connections = rebuild(connections, 1);
+        size        = connections->size.load(std::memory_order_relaxed);
+    }
+
+    auto link                = std::make_shared<Link>(slot);
+    connections->items[size] = link;
+    connections->size.store(size + 1, std::memory_order_release);
+    if (!slot->m_shared) {
+        m_exclusive = link;
+    }
+
+    return Connection(link);
+}
+
+template <typename... Args>
+typename Event<Args...>::Connections* Event<Args...>::rebuild(Connections* current, size_t reserve)
+{
+    size_t size = current ? current->size.load(std::memory_order_relaxed) : 0;
+    size_t live = 0;
+    for (size_t i = 0; i < size; ++i) {
+        live += current->items[i]->isAlive() ? 1 : 0;
+    }
+
+    auto   connections = new Connections(std::max<size_t>(4, (live + reserve) * 2));
+    size_t pos         = 0;
+    for (size_t i = 0; i < size && pos < live; ++i) {
+        if (current->items[i]->isAlive()) {
+            connections->items[pos++] = current->items[i];
+        }
+    }
+    connections->size.store(pos, std::memory_order_relaxed);
+
+    m_connections.store(connections, std::memory_order_release);
+    if (current) {
+        // Emitters could still iterate over the old block
+        details::Epoch::retire([current]() {
+            delete current;
+        });
+    }
+    return connections;
+}
+
+template <typename... Args>
+template <typename... Params>
+void Event<Args...>::post(const LinkPtr& link, Params&&... args) const
+{
+    if constexpr (details::isQueueable<Args...>) {
+        auto params = std::make_tuple(std::decay_t<Args>(std::forward<Params>(args))...);
+
+        link->slot->m_executor([link, params = std::move(params)]() mutable {
+            // Guard keeps the callable while it runs, even if the last slot copy is destroyed meanwhile
+            details::Epoch::Guard guard;
+            const auto&           slot = link->slot;
+            if (slot->isAlive()) {
+                profiled(*link, [&]() {
+                    std::apply(
+                        [&](auto&... vals) {
+                            slot->call(std::move(vals)...);
+                        },
+                        params);
+                });
+            }
+        });
+    } else {
+        // Cannot be reached, queued slots are checked at construction
+        assert(false && "Queued slot with not queueable arguments");
+    }
+}
+
+template <typename... Args>
+template <typename Func>
+void Event<Args...>::profiled([[maybe_unused]] const Link& link, Func&& func)
+{
+#ifdef FTY_EVENT_PROFILING
+    auto start = std::chrono::steady_clock::now();
+    func();
+    link.calls.add(std::chrono::steady_clock::now() - start);
+#else
+    func();
+#endif
+}
+
+template <typename... Args>
+EventStatistics Event<Args...>::statistics() const
+{
+    EventStatistics stats;
+#ifdef FTY_EVENT_PROFILING
+    stats.name   = m_name;
+    stats.fanOut = m_fanOut.snapshot();
+
+    details::Epoch::Guard guard;
+    if (auto connections = m_connections.load(std::memory_order_acquire)) {
+        size_t size = connections->size.load(std::memory_order_acquire);
+        for (size_t i = 0; i < size; ++i) {
+            const auto& link = connections->items[i];
+            if (link->isAlive()) {
+                stats.slots.push_back({link->slot->m_name, link->calls.snapshot()});
+            }
+        }
+    }
+#endif
+    return stats;
+}
+
+template <typename... Args>
+Event<Args...>::Connections::Connections(size_t capacity)
+    : items(capacity)
+{
+}
+
+template <typename... Args>
+Event<Args...>::Link::Link(const SlotImplPtr& impl)
+    : slot(impl)
+{
 }
 
 template <typename... Args>
-void Event<Args...>::connect(Slot<Args...>& slot)
+bool Event<Args...>::Link::isAlive() const
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_connections.emplace_back(slot.m_impl);
+    return connected.load(std::memory_order_relaxed) && slot->isAlive();
 }
 
 template <typename... Args>
 void Event<Args...>::wait()
 {
-    std::unique_lock<std::mutex> lock(m_mutex);
-    m_cv.wait(lock, [&]() {
-        return m_stopped || m_fired;
-    });
-    m_fired = false;
+    waitFor(nullptr);
 }
 
 template <typename... Args>
@@ -169,69 +882,230 @@ template <typename... Args>
 template <typename Rep, typename Period>
 Expected<void> Event<Args...>::wait(const std::chrono::duration<Rep, Period>& timeout)
 {
-    std::unique_lock<std::mutex> lock(m_mutex);
-    auto ret = m_cv.wait_for(lock, timeout, [&]() {
-        return m_stopped || m_fired;
-    });
-
-    if (!ret) {
+    std::chrono::nanoseconds nsec = timeout;
+    if (!waitFor(&nsec)) {
         return unexpected("timeout");
+    }
+    return {};
+}
+
+template <typename... Args>
+bool Event<Args...>::waitFor(const std::chrono::nanoseconds* timeout)
+{
+    // Emitted since the previous wait
+    uint32_t generation = m_generation.load();
+    if (generation != m_waited.load() || m_stopped) {
+        m_waited = generation;
+        return true;
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + (timeout ? *timeout : std::chrono::nanoseconds::zero());
+    while (true) {
+        std::chrono::nanoseconds left = deadline - std::chrono::steady_clock::now();
+        if (timeout && left.count() <= 0) {
+            return false;
+        }
+
+        ++m_waiters;
+        details::futexWait(m_generation, generation, timeout ? &left : nullptr);
+        --m_waiters;
+
+        if (uint32_t current = m_generation.load(); current != generation) {
+            m_waited = current;
+            return true;
+        }
+    }
+}
+
+// ===========================================================================================================
+
+template <typename... Args>
+Slot<Args...>::Impl::Impl(Executor executor, bool shared)
+    : m_executor(std::move(executor))
+    , m_shared(shared)
+{
+}
+
+template <typename... Args>
+bool Slot<Args...>::Impl::isAlive() const
+{
+    return m_owners.load(std::memory_order_acquire) != 0;
+}
+
+template <typename... Args>
+template <typename Func, typename Mutex>
+template <typename F>
+Slot<Args...>::Callable<Func, Mutex>::Callable(F&& func, Executor&& executor)
+    : Impl(std::move(executor), byRef || byCopy)
+    , m_function(std::in_place, std::forward<F>(func))
+{
+}
+
+template <typename... Args>
+template <typename Func, typename Mutex>
+void Slot<Args...>::Callable<Func, Mutex>::call(Args&&... args) const
+{
+    std::lock_guard<Mutex> lock(m_mutex);
+    (*m_function)(std::forward<Args>(args)...);
+}
+
+template <typename... Args>
+template <typename Func, typename Mutex>
+void Slot<Args...>::Callable<Func, Mutex>::callRef(details::Cref<Args>... args) const
+{
+    if constexpr (byRef) {
+        std::lock_guard<Mutex> lock(m_mutex);
+        (*m_function)(std::forward<details::Cref<Args>>(args)...);
+    } else if constexpr (byCopy) {
+        // Slot takes ownership of the values (by value or by rvalue reference), it gets its own copies
+        std::lock_guard<Mutex> lock(m_mutex);
+        (*m_function)(details::owned<Args>(std::forward<details::Cref<Args>>(args))...);
     } else {
-        m_fired = false;
-        return {};
+        // Event::connect() does not let such a slot share the event with other slots, only emit() gets here
+        throw std::logic_error("Slot takes ownership of not copyable arguments, emit with operator() instead");
     }
 }
 
+template <typename... Args>
+template <typename Func, typename Mutex>
+void Slot<Args...>::Callable<Func, Mutex>::release()
+{
+    m_function.reset();
+}
+
 // ===========================================================================================================
 
 template <typename... Args>
 template <typename Func, typename Cls>
-Slot<Args...>::Impl::Impl(Func&& func, Cls* cls)
-    : m_function([fnc = std::move(func), caller = std::move(cls)](Args&&... args) {
-        std::invoke(fnc, caller, std::forward<Args>(args)...);
-    })
+Slot<Args...>::Slot(Func&& func, Cls* cls, SlotPolicy policy)
+    : m_impl(create(bind(std::forward<Func>(func), cls), Executor{}, policy))
 {
 }
 
 template <typename... Args>
 template <typename Func>
-Slot<Args...>::Impl::Impl(Func&& func)
-    : m_function(std::move(func))
+Slot<Args...>::Slot(Func&& func, SlotPolicy policy)
+    : m_impl(create(std::forward<Func>(func), Executor{}, policy))
 {
 }
 
 template <typename... Args>
-void Slot<Args...>::Impl::call(Args&&... args) const
+template <typename Func, typename Cls>
+Slot<Args...>::Slot(Func&& func, Cls* cls, Executor executor, SlotPolicy policy)
+    : m_impl(create(bind(std::forward<Func>(func), cls), std::move(executor), policy))
 {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    m_function(std::forward<Args>(args)...);
+    static_assert(details::isQueueable<Args...>, "Queued slot arguments must be copyable and not modifiable references");
 }
 
-// ===========================================================================================================
+template <typename... Args>
+template <typename Func>
+Slot<Args...>::Slot(Func&& func, Executor executor, SlotPolicy policy)
+    : m_impl(create(std::forward<Func>(func), std::move(executor), policy))
+{
+    static_assert(details::isQueueable<Args...>, "Queued slot arguments must be copyable and not modifiable references");
+}
 
 template <typename... Args>
 template <typename Func, typename Cls>
-Slot<Args...>::Slot(Func&& func, Cls* cls)
-    : m_impl(new Impl(std::forward<Func>(func), cls))
+auto Slot<Args...>::bind(Func&& func, Cls* cls)
 {
+    return [fnc = std::forward<Func>(func), cls](auto&&... args) {
+        std::invoke(fnc, cls, std::forward<decltype(args)>(args)...);
+    };
 }
 
 template <typename... Args>
 template <typename Func>
-Slot<Args...>::Slot(Func&& func)
-    : m_impl(new Impl(std::forward<Func>(func)))
+std::shared_ptr<typename Slot<Args...>::Impl> Slot<Args...>::create(Func&& func, Executor&& executor, SlotPolicy policy)
 {
+    using FuncT = std::decay_t<Func>;
+    if (policy == SlotPolicy::Serialized) {
+        return std::make_shared<Callable<FuncT, std::mutex>>(std::forward<Func>(func), std::move(executor));
+    }
+    return std::make_shared<Callable<FuncT, details::NoMutex>>(std::forward<Func>(func), std::move(executor));
+}
+
+template <typename... Args>
+Slot<Args...>::Slot(const Slot& other)
+    : m_impl(other.m_impl)
+{
+    if (m_impl) {
+        m_impl->m_owners.fetch_add(1, std::memory_order_relaxed);
+    }
 }
 
 template <typename... Args>
 Slot<Args...>::~Slot()
 {
+    if (m_impl && m_impl->m_owners.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        // Events keep the state until they drop the connection, the callable is destroyed as soon as no emitter
+        // could be calling it
+        details::Epoch::retire([impl = std::move(m_impl)]() {
+            impl->release();
+        });
+    }
 }
 
 template <typename... Args>
-void Slot<Args...>::connect(Event<Args...>& signal)
+Connection Slot<Args...>::connect(Event<Args...>& signal)
+{
+    return signal.connect(*this);
+}
+
+template <typename... Args>
+void Slot<Args...>::setName([[maybe_unused]] const std::string& name)
+{
+#ifdef FTY_EVENT_PROFILING
+    m_impl->m_name = name;
+#endif
+}
+
+// ===========================================================================================================
+
+inline Connection::Connection(std::weak_ptr<details::ConnectionLink> link)
+    : m_link(std::move(link))
+{
+}
+
+inline void Connection::disconnect()
+{
+    if (auto link = m_link.lock()) {
+        link->disconnect();
+    }
+    m_link.reset();
+}
+
+inline bool Connection::isConnected() const
+{
+    auto link = m_link.lock();
+    return link && link->isAlive();
+}
+
+// ===========================================================================================================
+
+inline ScopedConnection::ScopedConnection(Connection&& connection)
+    : Connection(std::move(connection))
+{
+}
+
+inline ScopedConnection& ScopedConnection::operator=(ScopedConnection&& other)
+{
+    if (this != &other) {
+        disconnect();
+        Connection::operator=(other.release());
+    }
+    return *this;
+}
+
+inline ScopedConnection::~ScopedConnection()
+{
+    disconnect();
+}
+
+inline Connection ScopedConnection::release()
 {
-    signal.connect(*this);
+    // Moved from weak pointer is empty, so nothing is left to disconnect
+    return Connection(std::move(static_cast<Connection&>(*this)));
 }
 
 // ===========================================================================================================
@@ -17,8 +17,10 @@
 #include "convert.h"
 #include <cassert>
 #include <fmt/format.h>
+#include <new>
 #include <optional>
 #include <string>
+#include <type_traits>
 
 namespace fty {
 
@@ -79,6 +81,7 @@ public:
     Expected(Unexpected<UnErrorT>&& unex) noexcept;
     template <typename UnErrorT>
     Expected(const Unexpected<UnErrorT>& unex) noexcept;
+    Expected(Expected&&) noexcept = default;
 
     Expected(const Expected&) = delete;
     Expected& operator=(const Expected&) = delete;
@@ -149,12 +152,13 @@ constexpr Expected<T, ErrorT>::Expected(T&& value) noexcept
 
 template <typename T, typename ErrorT>
 constexpr Expected<T, ErrorT>::Expected(Expected&& other) noexcept
+    : m_isError(other.m_isError)
 {
-    if (other.m_isError) {
-        m_isError = true;
-        m_error   = std::move(other.m_error);
+    // Union members are not constructed yet, so they cannot be assigned
+    if (m_isError) {
+        new (&m_error) ErrorT(std::move(other.m_error));
     } else {
-        m_value = std::move(other.m_value);
+        new (&m_value) T(std::move(other.m_value));
     }
 }
 
@@ -0,0 +1,162 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace fty {
+
+// ===========================================================================================================
+
+/// Lock free histogram of durations.
+/// Values are stored in microseconds in power of two buckets: bucket 0 holds 0us, bucket N holds values in
+/// range [2^(N-1), 2^N) us, the last bucket holds everything bigger.
+class Histogram
+{
+public:
+    static constexpr size_t BucketsCount = 32;
+
+    using Duration = std::chrono::microseconds;
+    using Buckets  = std::array<uint64_t, BucketsCount>;
+
+    /// Copy of the histogram values at some point
+    struct Snapshot
+    {
+        uint64_t count = 0;
+        Duration total = Duration::zero();
+        Duration max   = Duration::zero();
+        Buckets  buckets{};
+
+        /// Returns average duration
+        Duration average() const;
+        /// Returns upper bound of the bucket which contains requested percentile (0..100)
+        Duration percentile(double percent) const;
+    };
+
+public:
+    Histogram() = default;
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    /// Adds value to the histogram, negative values are counted as zero
+    template <typename Rep, typename Period>
+    void add(const std::chrono::duration<Rep, Period>& value);
+
+    /// Returns current values
+    Snapshot snapshot() const;
+
+    /// Clears histogram
+    void reset();
+
+    /// Returns upper bound of the bucket, values in the bucket are less than it: 1us for bucket 0, 2^N us for
+    /// bucket N. The last bucket has no bound, its limit is only the label of the bucket.
+    static Duration bucketLimit(size_t bucket);
+
+private:
+    static size_t bucket(uint64_t usec);
+
+private:
+    std::array<std::atomic<uint64_t>, BucketsCount> m_buckets{};
+    std::atomic<uint64_t>                           m_count = 0;
+    std::atomic<uint64_t>                           m_total = 0;
+    std::atomic<uint64_t>                           m_max   = 0;
+};
+
+// ===========================================================================================================
+
+template <typename Rep, typename Period>
+void Histogram::add(const std::chrono::duration<Rep, Period>& value)
+{
+    auto     usec = std::chrono::duration_cast<Duration>(value).count();
+    uint64_t val  = usec > 0 ? uint64_t(usec) : 0;
+
+    m_buckets[bucket(val)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_total.fetch_add(val, std::memory_order_relaxed);
+
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (val > max && !m_max.compare_exchange_weak(max, val, std::memory_order_relaxed)) {
+    }
+}
+
+inline Histogram::Snapshot Histogram::snapshot() const
+{
+    Snapshot snap;
+    for (size_t i = 0; i < BucketsCount; ++i) {
+        snap.buckets[i] = m_buckets[i].load(std::memory_order_relaxed);
+    }
+    snap.count = m_count.load(std::memory_order_relaxed);
+    snap.total = Duration(m_total.load(std::memory_order_relaxed));
+    snap.max   = Duration(m_max.load(std::memory_order_relaxed));
+    return snap;
+}
+
+inline void Histogram::reset()
+{
+    for (auto& it : m_buckets) {
+        it.store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_total.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+inline Histogram::Duration Histogram::bucketLimit(size_t bucket)
+{
+    return Duration(uint64_t(1) << std::min<size_t>(bucket, 62));
+}
+
+inline size_t Histogram::bucket(uint64_t usec)
+{
+    size_t idx = 0;
+    while (usec && idx < BucketsCount - 1) {
+        usec >>= 1;
+        ++idx;
+    }
+    return idx;
+}
+
+// ===========================================================================================================
+
+inline Histogram::Duration Histogram::Snapshot::average() const
+{
+    return count ? Duration(total.count() / Duration::rep(count)) : Duration::zero();
+}
+
+inline Histogram::Duration Histogram::Snapshot::percentile(double percent) const
+{
+    if (!count) {
+        return Duration::zero();
+    }
+
+    uint64_t needed = uint64_t(double(count) * percent / 100.);
+    uint64_t sum    = 0;
+    for (size_t i = 0; i < BucketsCount; ++i) {
+        sum += buckets[i];
+        if (sum >= needed && buckets[i]) {
+            return i + 1 < BucketsCount ? bucketLimit(i) : max;
+        }
+    }
+    return max;
+}
+
+// ===========================================================================================================
+
+} // namespace fty
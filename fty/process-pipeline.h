@@ -0,0 +1,430 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#pragma once
+#include "fty/process.h"
+#include <algorithm>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <thread>
+
+namespace fty {
+
+// =========================================================================================================================================
+
+/// Runs commands connected as a shell pipeline, `cmd1 | cmd2 | ...`.
+/// Stdout of every stage is connected to stdin of the next one directly, the data does not go through the parent.
+/// Optional taps get a copy of the data flowing out of a stage, it is duplicated in the kernel (tee/splice). Taps
+/// are served by one thread per tap.
+class ProcessPipeline
+{
+public:
+    ProcessPipeline() = default;
+    ~ProcessPipeline();
+
+    ProcessPipeline(const ProcessPipeline&) = delete;
+    ProcessPipeline& operator=(const ProcessPipeline&) = delete;
+
+    /// Appends the stage to the pipeline
+    ProcessPipeline& add(const std::string& cmd, const Process::Arguments& args = {});
+
+    /// Copies stdout of the stage to fd, which could be a file, a pipe or a socket. Descriptor is not owned by the
+    /// pipeline and must stay opened until wait(). Tap of the last stage requires Capture::Out.
+    ProcessPipeline& tap(size_t stage, int fd);
+
+    /// Starts all the stages. Capture::In is stdin of the first stage, Capture::Out is stdout of the last one,
+    /// Capture::Err is stderr of all the stages. Not captured channels are inherited.
+    Expected<void> run(Capture capture = Capture::Out);
+
+    /// Waits for all the stages and returns their exit codes in the order of stages. Negative timeout waits forever.
+    Expected<std::vector<int>> wait(int timeoutMs = -1);
+
+    /// Reads stdout of the last stage, see Process::readAllStandardOutput()
+    std::string readAllStandardOutput(int milliseconds = -1);
+    /// Reads stdout of the last stage and stderr of all the stages, see Process::readAll()
+    bool readAll(std::string& out, std::string& err, int milliseconds = -1);
+
+    bool write(const std::string& data);
+    void closeWriteChannel();
+
+    /// Kills all the running stages
+    void kill();
+
+    size_t size() const;
+
+private:
+    struct Stage
+    {
+        std::string        cmd;
+        Process::Arguments args;
+        pid_t              pid   = 0;
+        int                pidfd = -1;
+        int                tap   = -1;
+    };
+
+    static void pump(int from, int to, int tap);
+    void        cleanup();
+    void        reaped(Stage& stage);
+
+private:
+    std::vector<Stage>       m_stages;
+    std::vector<std::thread> m_taps;
+    int                      m_stdin  = 0;
+    int                      m_stdout = 0;
+    int                      m_stderr = 0;
+};
+
+// =========================================================================================================================================
+
+inline ProcessPipeline::~ProcessPipeline()
+{
+    kill();
+    cleanup();
+}
+
+inline ProcessPipeline& ProcessPipeline::add(const std::string& cmd, const Process::Arguments& args)
+{
+    m_stages.push_back({cmd, args});
+    return *this;
+}
+
+inline ProcessPipeline& ProcessPipeline::tap(size_t stage, int fd)
+{
+    if (stage < m_stages.size()) {
+        m_stages[stage].tap = fd;
+    }
+    return *this;
+}
+
+inline size_t ProcessPipeline::size() const
+{
+    return m_stages.size();
+}
+
+inline Expected<void> ProcessPipeline::run(Capture capture)
+{
+    if (m_stages.empty()) {
+        return unexpected("Pipeline is empty");
+    }
+    if (m_stages.back().tap >= 0 && !isSet(capture, Capture::Out)) {
+        return unexpected("Tap of the last stage requires captured output");
+    }
+
+    // All the descriptors are close-on-exec, stages get only the ones duplicated to their stdin/stdout/stderr.
+    // Otherwise a stage would keep the write end of its own input and never see the end of file.
+    int errPipe[2] = {-1, -1};
+    if (isSet(capture, Capture::Err)) {
+        if (pipe2(errPipe, O_CLOEXEC)) {
+            return unexpected("pipe returned an error");
+        }
+        m_stderr = errPipe[0];
+    }
+
+    int input = -1;
+    if (isSet(capture, Capture::In)) {
+        int inPipe[2];
+        if (pipe2(inPipe, O_CLOEXEC)) {
+            if (errPipe[1] >= 0) {
+                close(errPipe[1]);
+            }
+            cleanup();
+            return unexpected("pipe returned an error");
+        }
+        input   = inPipe[0];
+        m_stdin = inPipe[1];
+    }
+
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+#ifdef POSIX_SPAWN_USEVFORK
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_USEVFORK);
+#endif
+
+    auto fail = [&](const std::string& error) -> Expected<void> {
+        posix_spawnattr_destroy(&attr);
+        for (int fd : {input, errPipe[1]}) {
+            if (fd >= 0) {
+                close(fd);
+            }
+        }
+        kill();
+        cleanup();
+        return unexpected(error);
+    };
+
+    for (size_t i = 0; i < m_stages.size(); ++i) {
+        Stage& stage = m_stages[i];
+        bool   last  = i + 1 == m_stages.size();
+
+        // Stage writes to link, next stage (or the parent) reads from next
+        int link[2] = {-1, -1};
+        int next    = -1;
+        if (!last || isSet(capture, Capture::Out)) {
+            if (pipe2(link, O_CLOEXEC)) {
+                return fail("pipe returned an error");
+            }
+            next = link[0];
+
+            if (stage.tap >= 0) {
+                int copy[2];
+                if (pipe2(copy, O_CLOEXEC)) {
+                    close(link[0]);
+                    close(link[1]);
+                    return fail("pipe returned an error");
+                }
+                next = copy[0];
+                m_taps.emplace_back(&ProcessPipeline::pump, link[0], copy[1], stage.tap);
+            }
+        }
+
+        posix_spawn_file_actions_t action;
+        posix_spawn_file_actions_init(&action);
+        if (input >= 0) {
+            posix_spawn_file_actions_adddup2(&action, input, STDIN_FILENO);
+        }
+        if (link[1] >= 0) {
+            posix_spawn_file_actions_adddup2(&action, link[1], STDOUT_FILENO);
+        }
+        if (errPipe[1] >= 0) {
+            posix_spawn_file_actions_adddup2(&action, errPipe[1], STDERR_FILENO);
+        }
+
+        CharArray args(stage.cmd, stage.args);
+        int       spawned = posix_spawnp(&stage.pid, stage.cmd.data(), &action, &attr, args.data(), environ);
+        posix_spawn_file_actions_destroy(&action);
+
+        // Children have their copies, parent keeps only the input of the next stage
+        if (input >= 0) {
+            close(input);
+        }
+        if (link[1] >= 0) {
+            close(link[1]);
+        }
+        input = next;
+
+        if (spawned != 0) {
+            stage.pid = 0;
+            return fail(fmt::format("posix_spawnp of '{}' failed with error: {}", stage.cmd, strerror(spawned)));
+        }
+        stage.pidfd = details::pidfdOpen(stage.pid);
+    }
+
+    posix_spawnattr_destroy(&attr);
+    if (errPipe[1] >= 0) {
+        close(errPipe[1]);
+    }
+    if (input >= 0) {
+        m_stdout = input;
+    }
+    return {};
+}
+
+inline Expected<std::vector<int>> ProcessPipeline::wait(int timeoutMs)
+{
+    closeWriteChannel();
+
+    std::vector<int> codes(m_stages.size(), 0);
+    auto             deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    auto             pause    = std::chrono::microseconds(100);
+
+    // Event driven as Process::wait(), stages are polled only on kernels without pidfd
+    bool pidfds = std::all_of(m_stages.begin(), m_stages.end(), [](const Stage& stage) {
+        return !stage.pid || stage.pidfd >= 0;
+    });
+
+    while (true) {
+        std::vector<pollfd> pfds;
+        for (size_t i = 0; i < m_stages.size(); ++i) {
+            Stage& stage = m_stages[i];
+            if (!stage.pid) {
+                continue;
+            }
+
+            int   status = 0;
+            pid_t pid    = details::waitChild(stage.pid, stage.cmd, status, timeoutMs < 0 && !pidfds ? 0 : WNOHANG);
+            if (pid == -1) {
+                return unexpected("waitpid error");
+            }
+            if (pid == 0) {
+                pfds.push_back({stage.pidfd, POLLIN, 0});
+                continue;
+            }
+
+            reaped(stage);
+            if (auto code = details::exitCode(status)) {
+                codes[i] = *code;
+            } else {
+                return unexpected(code.error());
+            }
+        }
+
+        if (pfds.empty()) {
+            break;
+        }
+
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (timeoutMs >= 0 && left.count() < 0) {
+            return unexpected("timeout");
+        }
+
+        if (pidfds) {
+            // Rounded up, so we never wake up just before the deadline
+            if (::poll(pfds.data(), pfds.size(), timeoutMs < 0 ? -1 : int(left.count()) + 1) == -1 && errno != EINTR) {
+                return unexpected("poll error: {}", strerror(errno));
+            }
+        } else {
+            std::this_thread::sleep_for(pause);
+            pause = std::min<std::chrono::microseconds>(pause * 2, std::chrono::milliseconds(100));
+        }
+    }
+
+    // Stages are finished, taps get the end of file
+    for (auto& th : m_taps) {
+        th.join();
+    }
+    m_taps.clear();
+    return codes;
+}
+
+inline std::string ProcessPipeline::readAllStandardOutput(int milliseconds)
+{
+    return readFromFd(m_stdout, milliseconds);
+}
+
+inline bool ProcessPipeline::readAll(std::string& out, std::string& err, int milliseconds)
+{
+    return details::readFromFds({m_stdout, m_stderr}, {&out, &err}, milliseconds, std::chrono::milliseconds(300));
+}
+
+inline bool ProcessPipeline::write(const std::string& data)
+{
+    if (m_stdin) {
+        return details::writeAll(m_stdin, data.c_str(), data.size());
+    }
+    return false;
+}
+
+inline void ProcessPipeline::closeWriteChannel()
+{
+    if (m_stdin) {
+        close(m_stdin);
+        m_stdin = 0;
+    }
+}
+
+inline void ProcessPipeline::kill()
+{
+    for (auto& stage : m_stages) {
+        if (stage.pid) {
+            ::kill(stage.pid, SIGKILL);
+            int status = 0;
+            details::waitChild(stage.pid, stage.cmd, status, 0);
+            reaped(stage);
+        }
+    }
+}
+
+inline void ProcessPipeline::reaped(Stage& stage)
+{
+    stage.pid = 0;
+    if (stage.pidfd >= 0) {
+        close(stage.pidfd);
+        stage.pidfd = -1;
+    }
+}
+
+inline void ProcessPipeline::cleanup()
+{
+    closeWriteChannel();
+    for (int* fd : {&m_stdout, &m_stderr}) {
+        if (*fd > 0) {
+            close(*fd);
+            *fd = 0;
+        }
+    }
+    // Writers are gone, taps see the end of file
+    for (auto& th : m_taps) {
+        th.join();
+    }
+    m_taps.clear();
+}
+
+inline void ProcessPipeline::pump(int from, int to, int tap)
+{
+    // Next stage could exit before reading everything, get EPIPE instead of the signal
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+    std::array<char, 64 * 1024> buffer;
+
+    // Moves count bytes from the pipe to the tap, the data is dropped if the tap does not accept it
+    auto consume = [&](size_t count) {
+        while (count) {
+            ssize_t bytes = tap >= 0 ? splice(from, nullptr, tap, nullptr, count, SPLICE_F_MOVE) : -1;
+            if (bytes < 0 && errno == EINTR) {
+                continue;
+            }
+            if (bytes <= 0) {
+                // Tap does not support splice (or is broken), plain copy
+                bytes = ::read(from, buffer.data(), std::min(count, buffer.size()));
+                if (bytes <= 0) {
+                    return;
+                }
+                if (tap >= 0 && ::write(tap, buffer.data(), size_t(bytes)) != bytes) {
+                    tap = -1;
+                }
+            }
+            count -= size_t(bytes);
+        }
+    };
+
+    while (true) {
+        // Duplicates the data to the next stage without consuming it
+        ssize_t bytes = tee(from, to, size_t(INT_MAX), 0);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            break;
+        }
+        consume(size_t(bytes));
+    }
+    close(to);
+
+    // Next stage is gone, the tap still gets the rest
+    while (true) {
+        ssize_t bytes = tap >= 0 ? splice(from, nullptr, tap, nullptr, buffer.size(), SPLICE_F_MOVE) : -1;
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes < 0) {
+            bytes = ::read(from, buffer.data(), buffer.size());
+            if (bytes > 0 && tap >= 0 && ::write(tap, buffer.data(), size_t(bytes)) != bytes) {
+                tap = -1;
+            }
+        }
+        if (bytes <= 0) {
+            break;
+        }
+    }
+    close(from);
+}
+
+// =========================================================================================================================================
+
+} // namespace fty
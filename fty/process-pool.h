@@ -0,0 +1,264 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#pragma once
+#include "fty/process.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+namespace fty {
+
+// =========================================================================================================================================
+
+/// Pool of long running helper processes.
+/// Workers are started once and serve requests over stdin/stdout, so the startup cost of the helper is paid once
+/// per worker, not once per request. Crashed workers are restarted, a worker which does not answer in time is
+/// killed and restarted as well. Requests could be sent from several threads, each one gets an idle worker.
+class ProcessPool
+{
+public:
+    enum class Framing
+    {
+        /// Request and response are one line, without the end of line
+        Line,
+        /// Request and response are prefixed by 4 bytes length, in network byte order
+        LengthPrefixed
+    };
+
+public:
+    ProcessPool(const std::string& cmd, const Process::Arguments& args = {}, size_t workers = 1, Framing framing = Framing::Line,
+        int timeoutMs = 5000);
+
+    ProcessPool(const ProcessPool&) = delete;
+    ProcessPool& operator=(const ProcessPool&) = delete;
+
+    /// Sends the request to an idle worker and returns its response. Negative timeout means the pool default.
+    Expected<std::string> request(const std::string& payload, int timeoutMs = -1);
+
+    /// Returns the number of worker restarts
+    size_t restarts() const;
+
+private:
+    struct Worker
+    {
+        std::unique_ptr<Process> process;
+        // Read but not consumed yet
+        std::string buffer;
+    };
+
+    Expected<void>        start(Worker& worker);
+    Expected<std::string> exchange(Worker& worker, const std::string& payload, int timeoutMs);
+    Expected<std::string> transfer(Worker& worker, const std::string& frame, std::chrono::steady_clock::time_point deadline);
+    bool                  extract(std::string& buffer, std::string& response) const;
+
+private:
+    std::string             m_cmd;
+    Process::Arguments      m_args;
+    Framing                 m_framing;
+    int                     m_timeoutMs;
+    std::vector<Worker>     m_workers;
+    std::vector<size_t>     m_idle;
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    std::atomic<size_t>     m_restarts = 0;
+};
+
+// =========================================================================================================================================
+
+inline ProcessPool::ProcessPool(const std::string& cmd, const Process::Arguments& args, size_t workers, Framing framing, int timeoutMs)
+    : m_cmd(cmd)
+    , m_args(args)
+    , m_framing(framing)
+    , m_timeoutMs(timeoutMs)
+    , m_workers(std::max<size_t>(workers, 1))
+{
+    // Workers are started on the first request
+    for (size_t i = 0; i < m_workers.size(); ++i) {
+        m_idle.push_back(i);
+    }
+}
+
+inline Expected<std::string> ProcessPool::request(const std::string& payload, int timeoutMs)
+{
+    if (m_framing == Framing::Line && payload.find('\n') != std::string::npos) {
+        return unexpected("Line request cannot contain end of line");
+    }
+
+    size_t index;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_cv.wait(lock, [&]() {
+            return !m_idle.empty();
+        });
+        index = m_idle.back();
+        m_idle.pop_back();
+    }
+
+    auto ret = exchange(m_workers[index], payload, timeoutMs < 0 ? m_timeoutMs : timeoutMs);
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_idle.push_back(index);
+    }
+    m_cv.notify_one();
+
+    return ret;
+}
+
+inline size_t ProcessPool::restarts() const
+{
+    return m_restarts;
+}
+
+inline Expected<void> ProcessPool::start(Worker& worker)
+{
+    if (worker.process) {
+        m_restarts++;
+    }
+
+    worker.buffer.clear();
+    worker.process = std::make_unique<Process>(m_cmd, m_args, Capture::In | Capture::Out);
+    if (auto ret = worker.process->run(); !ret) {
+        worker.process.reset();
+        return unexpected(ret.error());
+    }
+
+    fcntl(worker.process->m_stdout, F_SETFL, fcntl(worker.process->m_stdout, F_GETFL) | O_NONBLOCK);
+    fcntl(worker.process->m_stdin, F_SETFL, fcntl(worker.process->m_stdin, F_GETFL) | O_NONBLOCK);
+    return {};
+}
+
+inline Expected<std::string> ProcessPool::exchange(Worker& worker, const std::string& payload, int timeoutMs)
+{
+    // Worker could crash while idle
+    int status = 0;
+    if (!worker.process || worker.process->waitChild(status, WNOHANG) != 0) {
+        if (worker.process) {
+            worker.process->m_pid = 0;
+        }
+        if (auto ret = start(worker); !ret) {
+            return unexpected(ret.error());
+        }
+    }
+
+    std::string frame;
+    if (m_framing == Framing::Line) {
+        frame.reserve(payload.size() + 1);
+        frame.append(payload).push_back('\n');
+    } else {
+        uint32_t size = htonl(uint32_t(payload.size()));
+        frame.append(reinterpret_cast<const char*>(&size), sizeof(size)).append(payload);
+    }
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    auto ret      = transfer(worker, frame, deadline);
+    if (!ret) {
+        // Worker is in unknown state, the response could come later
+        start(worker);
+    }
+    return ret;
+}
+
+inline Expected<std::string> ProcessPool::transfer(
+    Worker& worker, const std::string& frame, std::chrono::steady_clock::time_point deadline)
+{
+    // Worker could exit at any moment, get EPIPE instead of SIGPIPE killing us
+    sigset_t pipeSet, oldSet;
+    sigemptyset(&pipeSet);
+    sigaddset(&pipeSet, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSet, &oldSet);
+
+    auto restore = [&](const char* error) -> Expected<std::string> {
+        if (errno == EPIPE) {
+            // Consume pending signal before unblocking it
+            timespec zero = {0, 0};
+            sigtimedwait(&pipeSet, nullptr, &zero);
+        }
+        pthread_sigmask(SIG_SETMASK, &oldSet, nullptr);
+        return unexpected(error);
+    };
+
+    // Request is written while reading, worker could answer before it read everything
+    std::string                 response;
+    size_t                      written = 0;
+    std::array<char, 64 * 1024> buffer;
+    while (written < frame.size() || !extract(worker.buffer, response)) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() < 0) {
+            return restore("timeout");
+        }
+
+        std::array<pollfd, 2> pfds = {{{worker.process->m_stdout, POLLIN, 0}, {worker.process->m_stdin, POLLOUT, 0}}};
+        if (::poll(pfds.data(), written < frame.size() ? 2 : 1, int(left.count()) + 1) <= 0) {
+            continue;
+        }
+
+        if (pfds[1].revents) {
+            ssize_t bytes = ::write(worker.process->m_stdin, frame.data() + written, frame.size() - written);
+            if (bytes > 0) {
+                written += size_t(bytes);
+            } else if (errno != EAGAIN && errno != EINTR) {
+                return restore("Cannot send the request to the worker");
+            }
+        }
+
+        if (pfds[0].revents) {
+            ssize_t bytes = ::read(worker.process->m_stdout, buffer.data(), buffer.size());
+            if (bytes > 0) {
+                worker.buffer.append(buffer.data(), size_t(bytes));
+            } else if (bytes == 0 || (errno != EAGAIN && errno != EINTR)) {
+                return restore("Worker exited");
+            }
+        }
+    }
+
+    pthread_sigmask(SIG_SETMASK, &oldSet, nullptr);
+    return response;
+}
+
+inline bool ProcessPool::extract(std::string& buffer, std::string& response) const
+{
+    if (m_framing == Framing::Line) {
+        size_t pos = buffer.find('\n');
+        if (pos == std::string::npos) {
+            return false;
+        }
+        response.assign(buffer, 0, pos);
+        buffer.erase(0, pos + 1);
+        return true;
+    }
+
+    uint32_t size;
+    if (buffer.size() < sizeof(size)) {
+        return false;
+    }
+    memcpy(&size, buffer.data(), sizeof(size));
+    size = ntohl(size);
+    if (buffer.size() < sizeof(size) + size) {
+        return false;
+    }
+    response.assign(buffer, sizeof(size), size);
+    buffer.erase(0, sizeof(size) + size);
+    return true;
+}
+
+// =========================================================================================================================================
+
+} // namespace fty
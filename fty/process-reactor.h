@@ -0,0 +1,406 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#pragma once
+#include "fty/process.h"
+#include <array>
+#include <atomic>
+#include <csignal>
+#include <functional>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace fty {
+
+// =========================================================================================================================================
+
+/// Runs processes from one reactor thread.
+/// Pidfds and stdin/stdout/stderr pipes of all the children are multiplexed on one epoll loop, so the number of
+/// threads does not grow with the number of running children. Completion is reported when the child exited and
+/// its output was read, through a future or through a callback. Callbacks are called from the reactor thread and
+/// should be short.
+class ProcessReactor
+{
+public:
+    struct Result
+    {
+        int         exitCode = 0;
+        std::string out;
+        std::string err;
+    };
+
+    using Callback = std::function<void(Expected<Result>&&)>;
+
+public:
+    ProcessReactor();
+    ~ProcessReactor();
+
+    ProcessReactor(const ProcessReactor&) = delete;
+    ProcessReactor& operator=(const ProcessReactor&) = delete;
+
+    /// Runs the command, input is written to its stdin
+    std::future<Expected<Result>> run(const std::string& cmd, const Process::Arguments& args = {}, const std::string& input = {});
+
+    /// Runs the command, input is written to its stdin. Callback is not called if the process cannot be started.
+    Expected<pid_t> run(const std::string& cmd, const Process::Arguments& args, Callback&& callback, const std::string& input = {});
+
+    /// Returns the number of not finished children
+    size_t running() const;
+
+private:
+    enum class Channel
+    {
+        Out,
+        Err,
+        In,
+        Pid
+    };
+
+    struct Child;
+
+    // Registered in epoll as event data
+    struct Handle
+    {
+        Child*  child = nullptr;
+        Channel channel;
+        int     fd = -1;
+    };
+
+    struct Child
+    {
+        std::unique_ptr<Process> process;
+        Callback                 callback;
+        std::string              input;
+        size_t                   written = 0;
+        Result                   result;
+        std::array<Handle, 4>    handles;
+        int                      opened = 0;
+        bool                     exited = false;
+    };
+
+    void worker();
+    bool dispatch(Handle& handle, uint32_t events);
+    void readOutput(Handle& handle, std::string& output);
+    void writeInput(Handle& handle);
+    void reap(Child& child);
+    void closeChannel(Handle& handle);
+
+private:
+    int                                      m_epoll  = -1;
+    int                                      m_wakeup = -1;
+    std::atomic<bool>                        m_stop   = false;
+    mutable std::mutex                       m_mutex;
+    std::map<Child*, std::unique_ptr<Child>> m_children;
+    // Children without pidfd (old kernels), polled by the reactor
+    size_t      m_polled = 0;
+    std::thread m_thread;
+};
+
+// =========================================================================================================================================
+
+inline ProcessReactor::ProcessReactor()
+    : m_epoll(epoll_create1(EPOLL_CLOEXEC))
+    , m_wakeup(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+{
+    epoll_event ev = {};
+    ev.events      = EPOLLIN;
+    ev.data.ptr    = nullptr;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_wakeup, &ev);
+
+    m_thread = std::thread(&ProcessReactor::worker, this);
+    pthread_setname_np(m_thread.native_handle(), "process reactor");
+}
+
+inline ProcessReactor::~ProcessReactor()
+{
+    m_stop = true;
+    uint64_t one = 1;
+    [[maybe_unused]] auto ret = ::write(m_wakeup, &one, sizeof(one));
+    m_thread.join();
+
+    // Not finished children are killed by Process destructor
+    for (auto& [ptr, child] : m_children) {
+        for (auto& handle : child->handles) {
+            closeChannel(handle);
+        }
+        if (child->callback) {
+            child->callback(unexpected("Process reactor stopped"));
+        }
+    }
+    m_children.clear();
+
+    close(m_wakeup);
+    close(m_epoll);
+}
+
+inline std::future<Expected<ProcessReactor::Result>> ProcessReactor::run(
+    const std::string& cmd, const Process::Arguments& args, const std::string& input)
+{
+    auto promise = std::make_shared<std::promise<Expected<Result>>>();
+    auto future  = promise->get_future();
+
+    auto ret = run(
+        cmd, args,
+        [promise](Expected<Result>&& result) {
+            promise->set_value(std::move(result));
+        },
+        input);
+
+    if (!ret) {
+        promise->set_value(unexpected(ret.error()));
+    }
+    return future;
+}
+
+inline Expected<pid_t> ProcessReactor::run(
+    const std::string& cmd, const Process::Arguments& args, Callback&& callback, const std::string& input)
+{
+    auto child     = std::make_unique<Child>();
+    child->process  = std::make_unique<Process>(cmd, args, Capture::Out | Capture::Err | Capture::In);
+    child->callback = std::move(callback);
+    child->input    = input;
+
+    auto pid = child->process->run();
+    if (!pid) {
+        return unexpected(pid.error());
+    }
+
+    Process& proc     = *child->process;
+    child->handles[0] = {child.get(), Channel::Out, proc.m_stdout};
+    child->handles[1] = {child.get(), Channel::Err, proc.m_stderr};
+    child->handles[2] = {child.get(), Channel::In, proc.m_stdin};
+    child->handles[3] = {child.get(), Channel::Pid, proc.m_pidfd};
+
+    // Reactor owns the descriptors from now on
+    proc.m_stdout = 0;
+    proc.m_stderr = 0;
+    proc.m_stdin  = 0;
+    proc.m_pidfd  = -1;
+
+    // Nothing to write, child gets end of file on its stdin
+    if (input.empty()) {
+        close(child->handles[2].fd);
+        child->handles[2].fd = -1;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (auto& handle : child->handles) {
+        if (handle.fd < 0) {
+            continue;
+        }
+
+        fcntl(handle.fd, F_SETFL, fcntl(handle.fd, F_GETFL) | O_NONBLOCK);
+
+        epoll_event ev = {};
+        ev.events      = handle.channel == Channel::In ? EPOLLOUT : EPOLLIN;
+        ev.data.ptr    = &handle;
+        epoll_ctl(m_epoll, EPOLL_CTL_ADD, handle.fd, &ev);
+        ++child->opened;
+    }
+
+    if (child->handles[3].fd < 0) {
+        ++m_polled;
+    }
+
+    Child* ptr = child.get();
+    m_children.emplace(ptr, std::move(child));
+
+    uint64_t one = 1;
+    [[maybe_unused]] auto ret = ::write(m_wakeup, &one, sizeof(one));
+
+    return *pid;
+}
+
+inline size_t ProcessReactor::running() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_children.size();
+}
+
+inline void ProcessReactor::worker()
+{
+    // Child could close its stdin before reading all the input, get EPIPE instead of the signal
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+    std::array<epoll_event, 64> events;
+    while (!m_stop) {
+        int timeout = -1;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            timeout = m_polled ? 10 : -1;
+        }
+
+        int count = epoll_wait(m_epoll, events.data(), int(events.size()), timeout);
+        if (count < 0 && errno != EINTR) {
+            break;
+        }
+
+        std::vector<std::unique_ptr<Child>> finished;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            std::vector<Child*>         done;
+
+            for (int i = 0; i < count; ++i) {
+                if (!events[size_t(i)].data.ptr) {
+                    uint64_t val;
+                    [[maybe_unused]] auto ret = ::read(m_wakeup, &val, sizeof(val));
+                    continue;
+                }
+
+                auto& handle = *static_cast<Handle*>(events[size_t(i)].data.ptr);
+                if (dispatch(handle, events[size_t(i)].events)) {
+                    done.push_back(handle.child);
+                }
+            }
+
+            if (m_polled) {
+                for (auto& [ptr, child] : m_children) {
+                    if (!child->exited && child->handles[3].fd < 0) {
+                        reap(*child);
+                        if (child->exited) {
+                            --m_polled;
+                            if (!child->opened) {
+                                done.push_back(ptr);
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Children are removed after all the events are handled, events could point to them
+            for (Child* ptr : done) {
+                if (auto it = m_children.find(ptr); it != m_children.end()) {
+                    finished.push_back(std::move(it->second));
+                    m_children.erase(it);
+                }
+            }
+        }
+
+        // Callbacks are called without lock, they could run new processes
+        for (auto& child : finished) {
+            child->callback(std::move(child->result));
+        }
+    }
+}
+
+inline bool ProcessReactor::dispatch(Handle& handle, uint32_t events)
+{
+    Child& child = *handle.child;
+    switch (handle.channel) {
+        case Channel::Out:
+            readOutput(handle, child.result.out);
+            break;
+        case Channel::Err:
+            readOutput(handle, child.result.err);
+            break;
+        case Channel::In:
+            if (events & (EPOLLERR | EPOLLHUP)) {
+                closeChannel(handle);
+            } else {
+                writeInput(handle);
+            }
+            break;
+        case Channel::Pid:
+            reap(child);
+            if (child.exited) {
+                closeChannel(handle);
+            }
+            break;
+    }
+
+    return child.opened == 0 && child.exited;
+}
+
+inline void ProcessReactor::readOutput(Handle& handle, std::string& output)
+{
+    static constexpr size_t chunk = 64 * 1024;
+
+    while (true) {
+        // Read directly into the result, no intermediate buffer
+        size_t size = output.size();
+        output.resize(size + chunk);
+        ssize_t bytes = ::read(handle.fd, &output[size], chunk);
+        output.resize(size + size_t(bytes > 0 ? bytes : 0));
+
+        if (bytes > 0) {
+            continue;
+        }
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        }
+        // End of file or error
+        closeChannel(handle);
+        return;
+    }
+}
+
+inline void ProcessReactor::writeInput(Handle& handle)
+{
+    Child& child = *handle.child;
+    while (child.written < child.input.size()) {
+        ssize_t bytes = ::write(handle.fd, child.input.data() + child.written, child.input.size() - child.written);
+        if (bytes > 0) {
+            child.written += size_t(bytes);
+        } else if (bytes < 0 && errno == EINTR) {
+            continue;
+        } else if (bytes < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return;
+        } else {
+            break;
+        }
+    }
+
+    // Everything is written (or child does not read anymore), send end of file
+    closeChannel(handle);
+}
+
+inline void ProcessReactor::reap(Child& child)
+{
+    int   status = 0;
+    pid_t pid    = child.process->waitChild(status, WNOHANG);
+    if (pid == child.process->m_pid) {
+        child.process->m_pid = 0;
+        child.exited         = true;
+        if (auto code = details::exitCode(status)) {
+            child.result.exitCode = *code;
+        }
+    }
+}
+
+inline void ProcessReactor::closeChannel(Handle& handle)
+{
+    if (handle.fd < 0) {
+        return;
+    }
+
+    epoll_ctl(m_epoll, EPOLL_CTL_DEL, handle.fd, nullptr);
+    close(handle.fd);
+    handle.fd = -1;
+    --handle.child->opened;
+}
+
+// =========================================================================================================================================
+
+} // namespace fty
@@ -0,0 +1,293 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#pragma once
+#include "fty/process.h"
+#include <atomic>
+#include <csignal>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+
+namespace fty {
+
+// =========================================================================================================================================
+
+/// Writes to stdin of the process without blocking the caller.
+/// Data is queued and written from a writer thread, as soon as the pipe accepts it. Queued buffers are coalesced
+/// in one writev call, so a lot of small writes does not mean a lot of syscalls. The caller could read the output
+/// of the process in the meantime, large inputs do not deadlock on a full stdout pipe.
+/// The writer takes over stdin of the process (Capture::In), it must be created after Process::run().
+class ProcessWriter
+{
+public:
+    /// Called with true when the queued size exceeds the high watermark, with false when it drops below half of it.
+    /// Called from the writer thread only, so the calls come in order and alternate. A short spike could be
+    /// reported late or not at all, but the last call always matches the current state.
+    using Backpressure = std::function<void(bool)>;
+
+public:
+    explicit ProcessWriter(Process& process, size_t highWatermark = 1024 * 1024, Backpressure&& onBackpressure = {});
+    /// Not written data is dropped
+    ~ProcessWriter();
+
+    ProcessWriter(const ProcessWriter&) = delete;
+    ProcessWriter& operator=(const ProcessWriter&) = delete;
+
+    /// Queues the data, returns false when the writer is closed or failed
+    bool write(std::string data);
+
+    /// Ends the input. Returned future is ready when all the queued data is written and stdin is closed, or on error.
+    std::future<Expected<void>> close();
+
+    /// Returns the size of not written data
+    size_t pending() const;
+
+private:
+    void worker();
+    bool flush();
+    void finish(Expected<void>&& result);
+    void wakeup();
+    void report();
+
+private:
+    int                          m_fd     = -1;
+    int                          m_wakeup = -1;
+    size_t                       m_high;
+    Backpressure                 m_onBackpressure;
+    mutable std::mutex           m_mutex;
+    std::deque<std::string>      m_queue;
+    // Already written part of the first buffer
+    size_t                       m_offset   = 0;
+    size_t                       m_pending  = 0;
+    bool                         m_full     = false;
+    // Last state given to the backpressure callback, touched by the writer thread only
+    bool                         m_reported = false;
+    bool                         m_closing  = false;
+    bool                         m_done     = false;
+    std::atomic<bool>            m_stop     = false;
+    std::promise<Expected<void>> m_result;
+    std::thread                  m_thread;
+};
+
+// =========================================================================================================================================
+
+inline ProcessWriter::ProcessWriter(Process& process, size_t highWatermark, Backpressure&& onBackpressure)
+    : m_fd(process.m_stdin > 0 ? process.m_stdin : -1)
+    , m_wakeup(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK))
+    , m_high(highWatermark)
+    , m_onBackpressure(std::move(onBackpressure))
+{
+    // Writer owns the descriptor from now on
+    process.m_stdin = 0;
+    if (m_fd < 0) {
+        m_done = true;
+        m_result.set_value(unexpected("Stdin of the process is not captured"));
+        return;
+    }
+
+    fcntl(m_fd, F_SETFL, fcntl(m_fd, F_GETFL) | O_NONBLOCK);
+    m_thread = std::thread(&ProcessWriter::worker, this);
+}
+
+inline ProcessWriter::~ProcessWriter()
+{
+    m_stop = true;
+    wakeup();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    if (!m_done) {
+        m_result.set_value(unexpected("Writer destroyed before all the data was written"));
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd);
+    }
+    ::close(m_wakeup);
+}
+
+inline bool ProcessWriter::write(std::string data)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closing || m_done) {
+            return false;
+        }
+        m_pending += data.size();
+        if (m_pending > m_high) {
+            m_full = true;
+        }
+        m_queue.push_back(std::move(data));
+    }
+    // Writer thread reports the backpressure
+    wakeup();
+    return true;
+}
+
+inline std::future<Expected<void>> ProcessWriter::close()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_closing) {
+            std::promise<Expected<void>> closed;
+            closed.set_value(unexpected("Writer is already closed"));
+            return closed.get_future();
+        }
+        m_closing = true;
+    }
+    wakeup();
+    return m_result.get_future();
+}
+
+inline size_t ProcessWriter::pending() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending;
+}
+
+inline void ProcessWriter::worker()
+{
+    // Child could close its stdin before reading everything, get EPIPE instead of the signal
+    sigset_t set;
+    sigemptyset(&set);
+    sigaddset(&set, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &set, nullptr);
+
+    while (!m_stop) {
+        bool empty;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            empty = m_queue.empty();
+            if (empty && m_closing) {
+                break;
+            }
+        }
+
+        // Pipe is watched only when there is something to write
+        std::array<pollfd, 2> pfds = {{{m_wakeup, POLLIN, 0}, {m_fd, POLLOUT, 0}}};
+        if (::poll(pfds.data(), empty ? 1 : 2, -1) < 0 && errno != EINTR) {
+            finish(unexpected("poll failed: {}", strerror(errno)));
+            return;
+        }
+
+        if (pfds[0].revents) {
+            uint64_t val;
+            [[maybe_unused]] auto ret = ::read(m_wakeup, &val, sizeof(val));
+        }
+
+        if (!empty && pfds[1].revents && !flush()) {
+            return;
+        }
+        report();
+    }
+
+    if (!m_stop) {
+        ::close(m_fd);
+        m_fd = -1;
+        finish({});
+    }
+}
+
+inline bool ProcessWriter::flush()
+{
+    static constexpr size_t maxBuffers = 64;
+
+    std::array<iovec, maxBuffers> iov;
+    size_t                        count = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_queue.begin(); it != m_queue.end() && count < maxBuffers; ++it, ++count) {
+            size_t skip = count == 0 ? m_offset : 0;
+            iov[count]  = {const_cast<char*>(it->data()) + skip, it->size() - skip};
+        }
+    }
+
+    // Queued strings are not touched by the callers, only appended, so iov stays valid without the lock
+    ssize_t written = ::writev(m_fd, iov.data(), int(count));
+    if (written < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return true;
+        }
+        if (errno == EPIPE) {
+            finish(unexpected("Process closed its input"));
+        } else {
+            finish(unexpected("write failed: {}", strerror(errno)));
+        }
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pending -= size_t(written);
+        size_t left = size_t(written);
+        while (left) {
+            size_t rest = m_queue.front().size() - m_offset;
+            if (left < rest) {
+                m_offset += left;
+                break;
+            }
+            left -= rest;
+            m_offset = 0;
+            m_queue.pop_front();
+        }
+        if (m_full && m_pending <= m_high / 2) {
+            m_full = false;
+        }
+    }
+    return true;
+}
+
+inline void ProcessWriter::finish(Expected<void>&& result)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_done = true;
+        m_queue.clear();
+        m_pending = 0;
+        m_offset  = 0;
+        m_full    = false;
+    }
+    // Producer waiting for the release must not wait forever
+    report();
+    m_result.set_value(std::move(result));
+}
+
+inline void ProcessWriter::report()
+{
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_full == m_reported) {
+            return;
+        }
+        m_reported = full = m_full;
+    }
+
+    if (m_onBackpressure) {
+        m_onBackpressure(full);
+    }
+}
+
+inline void ProcessWriter::wakeup()
+{
+    uint64_t one = 1;
+    [[maybe_unused]] auto ret = ::write(m_wakeup, &one, sizeof(one));
+}
+
+// =========================================================================================================================================
+
+} // namespace fty
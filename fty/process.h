@@ -14,13 +14,24 @@
     ========================================================================
 */
 #pragma once
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <fcntl.h>
 #include <fty/expected.h>
 #include <fty/flags.h>
+#include <functional>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <poll.h>
 #include <spawn.h>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <thread>
 #include <unistd.h>
 #include <vector>
@@ -35,26 +46,111 @@ enum class Capture
     None = 1 << 0,
     Out  = 1 << 1,
     Err  = 1 << 2,
-    In   = 1 << 3
+    In   = 1 << 3,
+    /// Stdout goes to an anonymous memory file, see Process::mappedOutput(). Exclusive with Out.
+    OutFile = 1 << 4
 };
 ENABLE_FLAGS(Capture)
 
+/// Read-only memory mapped output of the process, valid when the process object is gone
+class MappedOutput
+{
+public:
+    MappedOutput() = default;
+    MappedOutput(const char* data, size_t size);
+    MappedOutput(MappedOutput&& other) noexcept;
+    MappedOutput& operator=(MappedOutput&& other) noexcept;
+    ~MappedOutput();
+
+    MappedOutput(const MappedOutput&) = delete;
+    MappedOutput& operator=(const MappedOutput&) = delete;
+
+    std::string_view view() const;
+    size_t           size() const;
+
+private:
+    const char* m_data = nullptr;
+    size_t      m_size = 0;
+};
+
+/// Resources used by a finished process, see getrusage(2)
+struct ResourceUsage
+{
+    std::chrono::microseconds userTime   = {};
+    std::chrono::microseconds systemTime = {};
+    /// Peak resident set size, in kilobytes
+    long maxRss = 0;
+    /// Number of block input and output operations
+    long inBlocks  = 0;
+    long outBlocks = 0;
+};
+
+struct ExitStatus
+{
+    int           exitCode = 0;
+    ResourceUsage usage;
+};
+
+/// Usage of all the finished runs of one command. Times and I/O are summed, maxRss is the peak of all the runs.
+struct CommandStatistics
+{
+    size_t        runs = 0;
+    ResourceUsage usage;
+};
+
 class Process
 {
 public:
-    using Arguments = std::vector<std::string>;
+    using Arguments     = std::vector<std::string>;
+    using ChunkCallback = std::function<void(std::string_view)>;
     Process(const std::string& cmd, const Arguments& args = {}, Capture capture = Capture::Out | Capture::Err | Capture::In);
     ~Process();
 
     Expected<pid_t> run();
-    Expected<int>   wait(int timeoutMs = -1, uint32_t waitCycleDurationMs = 100);
 
+    /// Waits for the process end and returns its exit code.
+    /// Waiting with timeout is event driven (pidfd) and returns as soon as the process ends. On kernels without
+    /// pidfd support the process is polled, waitCycleDurationMs is the longest sleep between two checks then.
+    Expected<int> wait(int timeoutMs = -1, uint32_t waitCycleDurationMs = 100);
+    /// Same as wait(), returns the resource usage of the process with its exit code
+    Expected<ExitStatus> waitStatus(int timeoutMs = -1, uint32_t waitCycleDurationMs = 100);
+    /// Resource usage of the finished process
+    const ResourceUsage& usage() const;
+
+    /// Reads until the end of file or, if milliseconds is not negative, until the deadline. Without deadline,
+    /// reading also stops when the process writes nothing for 300ms.
     std::string readAllStandardError(int milliseconds = -1);
     std::string readAllStandardOutput(int milliseconds = -1);
+    /// Reads stdout and stderr concurrently and appends them to out and err, see readAllStandardOutput().
+    /// Returns true if the end of file was reached on both.
+    bool readAll(std::string& out, std::string& err, int milliseconds = -1);
+
+    /// Reads stdout (Capture::Out) or stderr (Capture::Err) until the end of file, while the process runs.
+    /// Every read chunk is passed to the callback, the view is valid during the call only. If milliseconds is
+    /// not negative, reading stops with "timeout" error after it.
+    Expected<void> readOutput(Capture channel, const ChunkCallback& onChunk, int milliseconds = -1);
+    /// Same as readOutput(), but the callback gets complete lines without the end of line. The last line without
+    /// the end of line is passed at the end of file only, not on timeout or error.
+    Expected<void> readLines(Capture channel, const ChunkCallback& onLine, int milliseconds = -1);
+    /// Maps the output captured with Capture::OutFile, once the process finished. Output is not copied, the view
+    /// stays valid as long as the returned object.
+    Expected<MappedOutput> mappedOutput() const;
+
+    /// Writes to stdin, blocks while the pipe is full. See ProcessWriter for writing without blocking.
     bool        write(const std::string& cmd);
     void        closeWriteChannel();
     void        setEnvVar(const std::string& name, const std::string& val);
     void        addArgument(const std::string& arg);
+    /// Sets capacity of the created pipes, see F_SETPIPE_SZ. Zero keeps the system default.
+    void setPipeSize(int size);
+    /// Limits the resource of the process, see setrlimit(2). Limits are applied before the command is executed,
+    /// run() fails and the process is killed if they cannot be applied.
+    void setLimit(int resource, rlim_t soft, rlim_t hard);
+    /// Same as setLimit(), soft and hard limits are the same
+    void setLimit(int resource, rlim_t limit);
+    /// Places the process in the cgroup v2 before the command is executed, path is the cgroup directory. run()
+    /// fails and the process is killed if it cannot be placed.
+    void setCgroup(const std::string& path);
 
     void interrupt();
     void kill();
@@ -62,42 +158,166 @@ public:
     bool exists();
 
 public:
-    static Expected<int> run(const std::string& cmd, const Arguments& args, std::string& out, std::string& err);
-    static Expected<int> run(const std::string& cmd, const Arguments& args, std::string& out);
+    /// Runs the command and returns its exit code. Output is read while the process runs, pipeSize sets the
+    /// capacity of the pipes (F_SETPIPE_SZ) for high volume commands.
+    static Expected<int> run(const std::string& cmd, const Arguments& args, std::string& out, std::string& err, int pipeSize = 0);
+    static Expected<int> run(const std::string& cmd, const Arguments& args, std::string& out, int pipeSize = 0);
     static Expected<int> run(const std::string& cmd, const Arguments& args);
 
+    /// Returns the usage of all the finished processes, by command
+    static std::map<std::string, CommandStatistics> statistics();
+
 private:
-    std::string              m_cmd;
-    std::vector<std::string> m_args;
-    std::vector<std::string> m_environ;
-    Capture                  m_capture;
-    pid_t                    m_pid    = 0;
-    int                      m_stdout = 0;
-    int                      m_stderr = 0;
-    int                      m_stdin  = 0;
+    friend class ProcessReactor;
+    friend class ProcessPool;
+    friend class ProcessWriter;
+
+    Expected<int>  waitPolling(int timeoutMs, uint32_t waitCycleDurationMs);
+    Expected<int>  drain(std::string& out, std::string& err);
+    void           reaped();
+    /// waitpid() which collects the resource usage of the finished process
+    pid_t          waitChild(int& status, int options);
+    Expected<void> applyRestrictions();
+
+private:
+    std::string                         m_cmd;
+    std::vector<std::string>            m_args;
+    // Overrides of the inherited environment, "name=value"
+    std::vector<std::string>            m_environ;
+    Capture                             m_capture;
+    pid_t                               m_pid      = 0;
+    int                                 m_stdout   = 0;
+    int                                 m_stderr   = 0;
+    int                                 m_stdin    = 0;
+    int                                 m_pidfd    = -1;
+    int                                 m_pipeSize = 0;
+    // Memory file with the output, Capture::OutFile
+    int                                 m_outFile  = -1;
+    // Applied by prlimit while the child is held before exec, see run()
+    std::vector<std::pair<int, rlimit>> m_limits;
+    std::string                         m_cgroup;
+    ResourceUsage                       m_usage;
 };
 
 // =========================================================================================================================================
 
+namespace details {
+    /// Returns file descriptor which becomes readable when the process ends, -1 if not supported by the kernel
+    inline int pidfdOpen(pid_t pid)
+    {
+#ifdef SYS_pidfd_open
+        return int(syscall(SYS_pidfd_open, pid, 0));
+#else
+        (void)pid;
+        errno = ENOSYS;
+        return -1;
+#endif
+    }
+
+    /// Converts waitpid status to the process exit code
+    inline Expected<int> exitCode(int status)
+    {
+        if (WIFEXITED(status)) {
+            return WEXITSTATUS(status);
+        } else if (WIFSIGNALED(status)) {
+            return WTERMSIG(status);
+        } else if (WIFSTOPPED(status)) {
+            return WSTOPSIG(status);
+        }
+        return unexpected("Impossible to identify reason for stop");
+    }
+
+    inline ResourceUsage resourceUsage(const rusage& usage)
+    {
+        ResourceUsage res;
+        res.userTime   = std::chrono::seconds(usage.ru_utime.tv_sec) + std::chrono::microseconds(usage.ru_utime.tv_usec);
+        res.systemTime = std::chrono::seconds(usage.ru_stime.tv_sec) + std::chrono::microseconds(usage.ru_stime.tv_usec);
+        res.maxRss     = usage.ru_maxrss;
+        res.inBlocks   = usage.ru_inblock;
+        res.outBlocks  = usage.ru_oublock;
+        return res;
+    }
+
+    struct StatisticsRegistry
+    {
+        std::mutex                               mutex;
+        std::map<std::string, CommandStatistics> commands;
+
+        static StatisticsRegistry& instance()
+        {
+            static StatisticsRegistry registry;
+            return registry;
+        }
+
+        void add(const std::string& cmd, const ResourceUsage& usage)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            CommandStatistics&          stat = commands[cmd];
+            stat.runs++;
+            stat.usage.userTime += usage.userTime;
+            stat.usage.systemTime += usage.systemTime;
+            stat.usage.maxRss = std::max(stat.usage.maxRss, usage.maxRss);
+            stat.usage.inBlocks += usage.inBlocks;
+            stat.usage.outBlocks += usage.outBlocks;
+        }
+    };
+
+    /// Same as wait4(), resource usage of the finished child is stored to @ref used and added to the statistics
+    inline pid_t waitChild(pid_t child, const std::string& cmd, int& status, int options, ResourceUsage* used = nullptr)
+    {
+        rusage usage;
+        pid_t  pid = wait4(child, &status, options, &usage);
+        if (pid == child && (WIFEXITED(status) || WIFSIGNALED(status))) {
+            ResourceUsage res = resourceUsage(usage);
+            StatisticsRegistry::instance().add(cmd, res);
+            if (used) {
+                *used = res;
+            }
+        }
+        return pid;
+    }
+
+    /// Writes all the data, retries partial and interrupted writes
+    inline bool writeAll(int fd, const char* data, size_t size)
+    {
+        size_t written = 0;
+        while (written < size) {
+            ssize_t ret = ::write(fd, data + written, size - written);
+            if (ret < 0 && errno == EINTR) {
+                continue;
+            }
+            if (ret <= 0) {
+                return false;
+            }
+            written += size_t(ret);
+        }
+        return true;
+    }
+
+    /// Descriptor of the gate pipe in a restricted child, see Process::run()
+    static constexpr int GateFd = 3;
+
+    /// Waits for the parent to open the gate, then replaces the shell by the command ($0) without the gate
+    static constexpr const char* GateScript = "read _ <&3 && exec \"$0\" \"$@\" 3<&-";
+} // namespace details
+
+// =========================================================================================================================================
+
+/// Null terminated array of C strings, as used for argv and envp.
+/// All the strings are stored in one contiguous buffer, so building the array costs a few allocations only.
 class CharArray
 {
 public:
+    CharArray() = default;
+
     template <typename... Args>
     CharArray(const Args&... args)
     {
         add(args...);
-        m_data.push_back(nullptr);
     }
 
     CharArray(const CharArray&) = delete;
 
-    ~CharArray()
-    {
-        for (size_t i = 0; i < m_data.size(); i++) {
-            delete[] m_data[i];
-        }
-    }
-
     template <typename... Args>
     void add(const std::string& arg, const Args&... args)
     {
@@ -107,10 +327,8 @@ public:
 
     void add(const std::string& str)
     {
-        char* s = new char[str.size() + 1];
-        memset(s, 0, str.size() + 1);
-        strncpy(s, str.c_str(), str.size());
-        m_data.push_back(s);
+        m_offsets.push_back(m_buffer.size());
+        m_buffer.append(str.c_str(), str.size() + 1);
     }
 
     void add(const std::vector<std::string>& vec)
@@ -122,21 +340,67 @@ public:
 
     char** data()
     {
+        // Pointers are resolved at the end, buffer could be reallocated while adding
+        m_data.clear();
+        m_data.reserve(m_offsets.size() + 1);
+        for (size_t offset : m_offsets) {
+            m_data.push_back(&m_buffer[offset]);
+        }
+        m_data.push_back(nullptr);
         return m_data.data();
     }
 
 private:
-    std::vector<char*> m_data;
+    std::string         m_buffer;
+    std::vector<size_t> m_offsets;
+    std::vector<char*>  m_data;
 };
 
+inline MappedOutput::MappedOutput(const char* data, size_t size)
+    : m_data(data)
+    , m_size(size)
+{
+}
+
+inline MappedOutput::MappedOutput(MappedOutput&& other) noexcept
+    : m_data(other.m_data)
+    , m_size(other.m_size)
+{
+    other.m_data = nullptr;
+    other.m_size = 0;
+}
+
+inline MappedOutput& MappedOutput::operator=(MappedOutput&& other) noexcept
+{
+    std::swap(m_data, other.m_data);
+    std::swap(m_size, other.m_size);
+    return *this;
+}
+
+inline MappedOutput::~MappedOutput()
+{
+    if (m_data) {
+        munmap(const_cast<char*>(m_data), m_size);
+    }
+}
+
+inline std::string_view MappedOutput::view() const
+{
+    return {m_data, m_size};
+}
+
+inline size_t MappedOutput::size() const
+{
+    return m_size;
+}
+
+// =========================================================================================================================================
+
 inline Process::Process(const std::string& cmd, const Arguments& args, Capture capture)
     : m_cmd(cmd)
     , m_args(args)
     , m_capture(capture)
 {
-    for (int i = 0; environ[i]; ++i) {
-        m_environ.push_back(environ[i]);
-    }
 }
 
 inline Process::~Process()
@@ -148,6 +412,16 @@ inline Process::~Process()
         kill();
         assert(true && "Process was running, killed...");
     }
+    if (m_stdout > 0) {
+        close(m_stdout);
+    }
+    if (m_stderr > 0) {
+        close(m_stderr);
+    }
+    if (m_outFile >= 0) {
+        close(m_outFile);
+    }
+    reaped();
 }
 
 inline Expected<pid_t> Process::run()
@@ -156,42 +430,124 @@ inline Expected<pid_t> Process::run()
     int cerrPipe[2];
     int cinPipe[2];
 
+    if (isSet(m_capture, Capture::OutFile)) {
+        if (isSet(m_capture, Capture::Out)) {
+            return unexpected("Output cannot be captured to a pipe and to a file");
+        }
+        if (m_outFile >= 0) {
+            close(m_outFile);
+        }
+        // Fixed name, the command could exceed the length memfd_create accepts
+        m_outFile = memfd_create("fty-process", MFD_CLOEXEC);
+        if (m_outFile < 0) {
+            return unexpected("memfd_create failed: {}", strerror(errno));
+        }
+    }
+
+    // Pipes are close-on-exec, so children running at the same time do not inherit each other ends and keep
+    // them open. adddup2 clears the flag on the copy the child gets.
     posix_spawn_file_actions_t action;
     posix_spawn_file_actions_init(&action);
 
+    if (m_outFile >= 0) {
+        // Child writes directly to the memory file, no pipe to read
+        posix_spawn_file_actions_adddup2(&action, m_outFile, STDOUT_FILENO);
+    }
+
     if (isSet(m_capture, Capture::Out)) {
-        if (pipe(coutPipe)) {
+        if (pipe2(coutPipe, O_CLOEXEC)) {
             return unexpected("pipe returned an error");
         }
+        if (m_pipeSize) {
+            fcntl(coutPipe[0], F_SETPIPE_SZ, m_pipeSize);
+        }
         posix_spawn_file_actions_addclose(&action, coutPipe[0]);
         posix_spawn_file_actions_adddup2(&action, coutPipe[1], STDOUT_FILENO);
         // posix_spawn_file_actions_addclose(&action, coutPipe[1]);
     }
 
     if (isSet(m_capture, Capture::Err)) {
-        if (pipe(cerrPipe)) {
+        if (pipe2(cerrPipe, O_CLOEXEC)) {
             return unexpected("pipe returned an error");
         }
+        if (m_pipeSize) {
+            fcntl(cerrPipe[0], F_SETPIPE_SZ, m_pipeSize);
+        }
         posix_spawn_file_actions_addclose(&action, cerrPipe[0]);
         posix_spawn_file_actions_adddup2(&action, cerrPipe[1], STDERR_FILENO);
         // posix_spawn_file_actions_addclose(&action, cerrPipe[1]);
     }
 
     if (isSet(m_capture, Capture::In)) {
-        if (pipe(cinPipe)) {
+        if (pipe2(cinPipe, O_CLOEXEC)) {
             return unexpected("pipe returned an error");
         }
+        if (m_pipeSize) {
+            fcntl(cinPipe[0], F_SETPIPE_SZ, m_pipeSize);
+        }
         posix_spawn_file_actions_addclose(&action, cinPipe[1]);
         posix_spawn_file_actions_adddup2(&action, cinPipe[0], STDIN_FILENO);
         // posix_spawn_file_actions_addclose(&action, cinPipe[1]);
     }
 
 
-    CharArray args(m_cmd, m_args);
-    CharArray env(m_environ);
+    posix_spawnattr_t attr;
+    posix_spawnattr_init(&attr);
+#ifdef POSIX_SPAWN_USEVFORK
+    // Child shares parent memory until exec, so spawn time does not depend on the parent size
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_USEVFORK);
+#endif
+
+    // posix_spawn cannot run code in the child. A restricted command is started through a shell which waits on
+    // the gate pipe, the parent applies the cgroup and the limits to it and only then lets it exec the command.
+    // An unknown command is then reported by the shell with exit code 127 instead of a run() error.
+    bool restricted = !m_cgroup.empty() || !m_limits.empty();
+    int  gate[2]    = {-1, -1};
+
+    CharArray args;
+    if (restricted) {
+        if (pipe2(gate, O_CLOEXEC)) {
+            posix_spawnattr_destroy(&attr);
+            posix_spawn_file_actions_destroy(&action);
+            return unexpected("pipe returned an error");
+        }
+        posix_spawn_file_actions_adddup2(&action, gate[0], details::GateFd);
+        args.add({"sh", "-c", details::GateScript, m_cmd});
+    } else {
+        args.add(m_cmd);
+    }
+    args.add(m_args);
+
+    // Inherited environment is passed as is, unless it is overridden
+    char**    envp = environ;
+    CharArray env;
+    if (!m_environ.empty()) {
+        for (int i = 0; environ[i]; ++i) {
+            std::string_view var  = environ[i];
+            std::string_view name = var.substr(0, var.find('='));
+
+            bool overridden = std::any_of(m_environ.begin(), m_environ.end(), [&](const std::string& over) {
+                return over.size() > name.size() && over[name.size()] == '=' && over.compare(0, name.size(), name) == 0;
+            });
+            if (!overridden) {
+                env.add(environ[i]);
+            }
+        }
+        env.add(m_environ);
+        envp = env.data();
+    }
 
-    if (posix_spawnp(&m_pid, m_cmd.data(), &action, nullptr, args.data(), env.data()) != 0) {
-        return unexpected("posix_spawnp failed with error: {}", strerror(errno));
+    int spawned = posix_spawnp(&m_pid, restricted ? "/bin/sh" : m_cmd.data(), &action, &attr, args.data(), envp);
+    posix_spawnattr_destroy(&attr);
+    if (restricted) {
+        close(gate[0]);
+    }
+    if (spawned != 0) {
+        if (restricted) {
+            close(gate[1]);
+        }
+        posix_spawn_file_actions_destroy(&action);
+        return unexpected("posix_spawnp failed with error: {}", strerror(spawned));
     }
 
     if (posix_spawn_file_actions_destroy(&action)) {
@@ -213,134 +569,305 @@ inline Expected<pid_t> Process::run()
         m_stdin = cinPipe[1];
     }
 
+    m_pidfd = details::pidfdOpen(m_pid);
+
+    if (restricted) {
+        auto ret = applyRestrictions();
+        if (ret) {
+            // Opens the gate, the shell execs the command
+            details::writeAll(gate[1], "\n", 1);
+        }
+        close(gate[1]);
+        if (!ret) {
+            kill();
+            return unexpected(ret.error());
+        }
+    }
+
     return m_pid;
 }
 
+inline Expected<void> Process::applyRestrictions()
+{
+    if (!m_cgroup.empty()) {
+        int fd = open((m_cgroup + "/cgroup.procs").c_str(), O_WRONLY | O_CLOEXEC);
+        if (fd < 0) {
+            return unexpected("Cannot open cgroup '{}': {}", m_cgroup, strerror(errno));
+        }
+        std::string pid     = std::to_string(m_pid);
+        bool        written = ::write(fd, pid.data(), pid.size()) == ssize_t(pid.size());
+        int         error   = errno;
+        close(fd);
+        if (!written) {
+            return unexpected("Cannot place the process in cgroup '{}': {}", m_cgroup, strerror(error));
+        }
+    }
+
+    for (const auto& [resource, limit] : m_limits) {
+        // Resource is an enum in glibc, int elsewhere
+        if (prlimit(m_pid, static_cast<decltype(RLIMIT_CPU)>(resource), &limit, nullptr) != 0) {
+            return unexpected("Cannot set limit {}: {}", resource, strerror(errno));
+        }
+    }
+    return {};
+}
+
 inline Expected<int> Process::wait(int timeoutMs, uint32_t waitCycleDurationMs)
 {
     closeWriteChannel();
     int status = 0;
 
-    // Wait with timeout is hard to do has the OS does not provid direct solution for it.
-    // We will do active waiting with step...
-    // This solution is thread safe
     if (timeoutMs >= 0) {
-
-        assert(waitCycleDurationMs);
-        if (waitCycleDurationMs == 0) {
-            return unexpected("Cycle duration has to be bigger than 0");
-        }
-
-        // Better to use number of cycle to wait, than using std::chrono, which require a syscall to have exact time.
-        uint32_t numberOfCycles = 0;
-
-        // Number of cycle is timeout (ms) / by the cycle duration (ms) and rounded to upper value
-        uint32_t maxNumberOfCycles = static_cast<uint32_t>(timeoutMs) / waitCycleDurationMs;
-        if (static_cast<uint32_t>(timeoutMs) % waitCycleDurationMs > 0) {
-            maxNumberOfCycles++;
+        if (m_pidfd < 0) {
+            return waitPolling(timeoutMs, waitCycleDurationMs);
         }
 
-        pid_t pid;
-        while (true) // endless loop
-        {
-            // Check if the process is stopped
-            if ((pid = waitpid(m_pid, &status, WNOHANG)) == -1) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+        while (true) {
+            pid_t pid = waitChild(status, WNOHANG);
+            if (pid == -1) {
                 return unexpected("waitpid error");
             }
 
-            // Child is still running
-            if (pid == 0) {
-                // Child is still running
+            if (pid != 0) {
+                m_pid = 0;
+                reaped();
+                return details::exitCode(status);
+            }
 
-                // Check if we waited enough
-                if (numberOfCycles > maxNumberOfCycles) {
-                    return unexpected("timeout");
-                }
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() < 0) {
+                return unexpected("timeout");
+            }
 
-                std::this_thread::sleep_for(std::chrono::milliseconds(waitCycleDurationMs));
-                numberOfCycles++;
-            } else {
-                m_pid = 0;
-                // Idenfity why we returned
-                if (WIFEXITED(status)) {
-                    return WEXITSTATUS(status);
-                } else if (WIFSIGNALED(status)) {
-                    return WTERMSIG(status);
-                } else if (WIFSTOPPED(status)) {
-                    return WSTOPSIG(status);
-                }
-                
-                return unexpected("Impossible to identify reason for stop");
+            // Rounded up, so we never wake up just before the deadline
+            pollfd pfd = {m_pidfd, POLLIN, 0};
+            if (::poll(&pfd, 1, int(left.count()) + 1) == -1 && errno != EINTR) {
+                return unexpected("poll error: {}", strerror(errno));
             }
         }
     }
 
     // We wait until the end of the program -> wait pid can return for several reason, and we want to get only when our pid returns
     do {
-        if (auto res = waitpid(m_pid, &status, WUNTRACED | WCONTINUED); res == -1) {
+        if (auto res = waitChild(status, WUNTRACED | WCONTINUED); res == -1) {
             return unexpected("waitpid error");
         }
 
         // Idenfity why we returned
-        if (WIFEXITED(status)) {
+        if (WIFEXITED(status) || WIFSIGNALED(status) || WIFSTOPPED(status)) {
             m_pid = 0;
-            return WEXITSTATUS(status);
-        } else if (WIFSIGNALED(status)) {
-            m_pid = 0;
-            return WTERMSIG(status);
-        } else if (WIFSTOPPED(status)) {
-            m_pid = 0;
-            return WSTOPSIG(status);
+            reaped();
+            return details::exitCode(status);
         }
     } while (!WIFEXITED(status) && !WIFSIGNALED(status));
 
     return unexpected("something wrong");
 }
 
-inline std::string readFromFd(int fd, int milliseconds, int maxretry = 2)
+inline Expected<ExitStatus> Process::waitStatus(int timeoutMs, uint32_t waitCycleDurationMs)
 {
-    std::array<char, 1024> buffer;
-    std::string            output;
-
-    timeval tv;
-    if (milliseconds > 0) {
-        tv.tv_sec  = milliseconds / 1000;
-        tv.tv_usec = (milliseconds % 1000) * 1000;
-    } else {
-        tv.tv_sec  = 0;
-        tv.tv_usec = 100 * 1000;
+    auto code = wait(timeoutMs, waitCycleDurationMs);
+    if (!code) {
+        return unexpected(code.error());
     }
+    return ExitStatus{*code, m_usage};
+}
+
+inline const ResourceUsage& Process::usage() const
+{
+    return m_usage;
+}
 
-    fd_set readSet;
-    FD_ZERO(&readSet);
-    FD_SET(fd, &readSet);
-    int exit = 0;
+inline pid_t Process::waitChild(int& status, int options)
+{
+    return details::waitChild(m_pid, m_cmd, status, options, &m_usage);
+}
 
-    int o_flags = fcntl(fd, F_GETFL);
-    int n_flags = o_flags | O_NONBLOCK;
-    fcntl(fd, F_SETFL, n_flags);
+inline Expected<int> Process::waitPolling(int timeoutMs, uint32_t waitCycleDurationMs)
+{
+    assert(waitCycleDurationMs);
+    if (waitCycleDurationMs == 0) {
+        return unexpected("Cycle duration has to be bigger than 0");
+    }
+
+    // Exponential backoff: short processes are noticed quickly, long ones do not burn wake-ups
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+    auto sleep    = std::chrono::microseconds(100);
+    auto maxSleep = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::milliseconds(waitCycleDurationMs));
 
+    int status = 0;
     while (true) {
-        if (int retval = select(fd + 1, &readSet, nullptr, nullptr, &tv); retval > 0) {
-            if (FD_ISSET(fd, &readSet)) {
-                if (auto bytesRead = read(fd, &buffer[0], buffer.size()); bytesRead > 0) {
-                    output += std::string(buffer.data(), size_t(bytesRead));
-                } else {
-                    if ((errno == EAGAIN || errno == EWOULDBLOCK) && exit < maxretry) {
-                        ++exit;
-                        continue;
-                    }
+        pid_t pid = waitChild(status, WNOHANG);
+        if (pid == -1) {
+            return unexpected("waitpid error");
+        }
+
+        if (pid != 0) {
+            m_pid = 0;
+            reaped();
+            return details::exitCode(status);
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        if (now >= deadline) {
+            return unexpected("timeout");
+        }
+
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(sleep, deadline - now));
+        sleep = std::min(sleep * 2, maxSleep);
+    }
+}
+
+inline Expected<MappedOutput> Process::mappedOutput() const
+{
+    if (m_outFile < 0) {
+        return unexpected("Output is not captured to a file");
+    }
+    if (m_pid) {
+        return unexpected("Process is still running");
+    }
+
+    struct stat st;
+    if (fstat(m_outFile, &st) != 0) {
+        return unexpected("fstat failed: {}", strerror(errno));
+    }
+    if (st.st_size == 0) {
+        // Empty file cannot be mapped
+        return MappedOutput();
+    }
+
+    void* data = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_PRIVATE, m_outFile, 0);
+    if (data == MAP_FAILED) {
+        return unexpected("mmap failed: {}", strerror(errno));
+    }
+    return MappedOutput(static_cast<const char*>(data), size_t(st.st_size));
+}
+
+inline void Process::reaped()
+{
+    if (m_pidfd >= 0) {
+        close(m_pidfd);
+        m_pidfd = -1;
+    }
+}
+
+namespace details {
+    /// Reads file descriptor until the end of file or the timeout, passing read chunks to the callback
+    inline Expected<void> streamFromFd(int fd, int milliseconds, const Process::ChunkCallback& onChunk)
+    {
+        static constexpr size_t BufferSize = 64 * 1024;
+
+        if (fd <= 0) {
+            return unexpected("channel is not captured");
+        }
+
+        if (milliseconds >= 0) {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        }
+
+        std::unique_ptr<char[]> buffer(new char[BufferSize]);
+        auto                    deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+
+        while (true) {
+            ssize_t bytes = ::read(fd, buffer.get(), BufferSize);
+            if (bytes > 0) {
+                onChunk(std::string_view(buffer.get(), size_t(bytes)));
+                continue;
+            }
+            if (bytes == 0) {
+                return {};
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                return unexpected("read error: {}", strerror(errno));
+            }
+
+            int timeout = -1;
+            if (milliseconds >= 0) {
+                auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+                if (left.count() < 0) {
+                    return unexpected("timeout");
+                }
+                timeout = int(left.count()) + 1;
+            }
+
+            pollfd pfd = {fd, POLLIN, 0};
+            if (::poll(&pfd, 1, timeout) == -1 && errno != EINTR) {
+                return unexpected("poll error: {}", strerror(errno));
+            }
+        }
+    }
+} // namespace details
+
+namespace details {
+    /// Reads descriptors concurrently, so a child cannot block on one full pipe while another one is read.
+    /// Reading ends on the end of file on all descriptors or, if milliseconds is not negative, on the deadline.
+    /// With negative milliseconds, reading also ends when nothing comes during quiet period, for children which
+    /// keep pipes open (interactive ones). Returns true if the end of file was reached on all descriptors.
+    inline bool readFromFds(
+        const std::array<int, 2>& fds, const std::array<std::string*, 2>& outputs, int milliseconds, std::chrono::milliseconds quiet)
+    {
+        std::array<char, 64 * 1024> buffer;
+        std::array<pollfd, 2>       pfds;
+        size_t                      opened = 0;
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            pfds[i] = {fds[i] > 0 ? fds[i] : -1, POLLIN, 0};
+            if (fds[i] > 0) {
+                fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+                ++opened;
+            }
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+        auto lastData = std::chrono::steady_clock::now();
+
+        while (opened) {
+            auto end  = milliseconds >= 0 ? deadline : lastData + quiet;
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(end - std::chrono::steady_clock::now());
+            if (left.count() < 0) {
+                break;
+            }
+
+            if (int ret = ::poll(pfds.data(), pfds.size(), int(left.count()) + 1); ret <= 0) {
+                if (ret < 0 && errno != EINTR) {
                     break;
                 }
+                continue;
+            }
+
+            for (size_t i = 0; i < pfds.size(); ++i) {
+                if (pfds[i].fd < 0 || !pfds[i].revents) {
+                    continue;
+                }
+
+                ssize_t bytes;
+                while ((bytes = ::read(pfds[i].fd, buffer.data(), buffer.size())) > 0) {
+                    outputs[i]->append(buffer.data(), size_t(bytes));
+                    lastData = std::chrono::steady_clock::now();
+                }
+
+                if (bytes == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    // End of file or error, poll ignores negative descriptors
+                    pfds[i].fd = -1;
+                    --opened;
+                }
             }
-        } else if (retval == 0 && exit < maxretry) {
-            ++exit;
-            continue;
-        } else {
-            break;
         }
+        return opened == 0;
     }
+} // namespace details
 
+/// Reads descriptor until the end of file or the deadline, see details::readFromFds(). Without deadline, reading
+/// ends when nothing comes for (maxretry + 1) * 100ms.
+inline std::string readFromFd(int fd, int milliseconds, int maxretry = 2)
+{
+    std::string output;
+    std::string unused;
+    details::readFromFds({fd, -1}, {&output, &unused}, milliseconds, std::chrono::milliseconds(100 * (maxretry + 1)));
     return output;
 }
 
@@ -354,12 +881,56 @@ inline std::string Process::readAllStandardError(int milliseconds)
     return readFromFd(m_stderr, milliseconds);
 }
 
+inline bool Process::readAll(std::string& out, std::string& err, int milliseconds)
+{
+    return details::readFromFds({m_stdout, m_stderr}, {&out, &err}, milliseconds, std::chrono::milliseconds(300));
+}
+
+inline Expected<void> Process::readOutput(Capture channel, const ChunkCallback& onChunk, int milliseconds)
+{
+    return details::streamFromFd(channel == Capture::Err ? m_stderr : m_stdout, milliseconds, onChunk);
+}
+
+inline Expected<void> Process::readLines(Capture channel, const ChunkCallback& onLine, int milliseconds)
+{
+    // Only a line split between two chunks is copied, others are passed directly from the read buffer
+    std::string partial;
+
+    auto ret = readOutput(
+        channel,
+        [&](std::string_view chunk) {
+            size_t pos;
+            while ((pos = chunk.find('\n')) != std::string_view::npos) {
+                if (partial.empty()) {
+                    onLine(chunk.substr(0, pos));
+                } else {
+                    partial.append(chunk.data(), pos);
+                    onLine(partial);
+                    partial.clear();
+                }
+                chunk.remove_prefix(pos + 1);
+            }
+            partial.append(chunk.data(), chunk.size());
+        },
+        milliseconds);
+
+    if (!ret) {
+        // Cut off line is not complete, it is not passed
+        return unexpected(ret.error());
+    }
+
+    // Last line without the end of line
+    if (!partial.empty()) {
+        onLine(partial);
+    }
+    return {};
+}
+
 inline bool Process::write(const std::string& cmd)
 {
     if (m_stdin) {
-        auto ret = ::write(m_stdin, cmd.c_str(), cmd.size());
-        fsync(m_stdin);
-        return ret == ssize_t(cmd.size());
+        // No fsync, it is useless on a pipe
+        return details::writeAll(m_stdin, cmd.c_str(), cmd.size());
     }
     return false;
 }
@@ -385,6 +956,33 @@ inline void Process::addArgument(const std::string& arg)
     m_args.push_back(arg);
 }
 
+inline void Process::setPipeSize(int size)
+{
+    m_pipeSize = size;
+}
+
+inline void Process::setLimit(int resource, rlim_t soft, rlim_t hard)
+{
+    m_limits.emplace_back(resource, rlimit{soft, hard});
+}
+
+inline void Process::setLimit(int resource, rlim_t limit)
+{
+    setLimit(resource, limit, limit);
+}
+
+inline void Process::setCgroup(const std::string& path)
+{
+    m_cgroup = path;
+}
+
+inline std::map<std::string, CommandStatistics> Process::statistics()
+{
+    auto&                       registry = details::StatisticsRegistry::instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.commands;
+}
+
 
 inline void Process::interrupt()
 {
@@ -392,9 +990,10 @@ inline void Process::interrupt()
         ::kill(m_pid, SIGINT);
         int status;
         do {
-            waitpid(m_pid, &status, WUNTRACED | WCONTINUED);
+            waitChild(status, WUNTRACED | WCONTINUED);
         } while (!WIFEXITED(status) && !WIFSIGNALED(status) && !WIFSTOPPED(status) && !WCOREDUMP(status));
         m_pid = 0;
+        reaped();
     }
 }
 
@@ -404,9 +1003,10 @@ inline void Process::kill()
         ::kill(m_pid, SIGKILL);
         int status;
         do {
-            waitpid(m_pid, &status, WUNTRACED | WCONTINUED);
+            waitChild(status, WUNTRACED | WCONTINUED);
         } while (!WIFEXITED(status) && !WIFSIGNALED(status) && !WIFSTOPPED(status) && !WCOREDUMP(status));
         m_pid = 0;
+        reaped();
     }
 }
 
@@ -418,33 +1018,45 @@ inline bool Process::exists()
     return false;
 }
 
-inline Expected<int> Process::run(const std::string& cmd, const Arguments& args, std::string& out, std::string& err)
+inline Expected<int> Process::run(const std::string& cmd, const Arguments& args, std::string& out, std::string& err, int pipeSize)
 {
     Process proc(cmd, args, Capture::Err | Capture::Out);
+    proc.setPipeSize(pipeSize);
     if (auto ret = proc.run(); !ret) {
         return unexpected(ret.error());
     }
-    out      = proc.readAllStandardOutput();
-    err      = proc.readAllStandardError();
-    auto ret = proc.wait();
-    out += proc.readAllStandardOutput();
-    err += proc.readAllStandardError();
-    if (ret) {
-        return *ret;
-    } else {
-        return unexpected(ret.error());
-    }
+    out.clear();
+    err.clear();
+    return proc.drain(out, err);
 }
 
-inline Expected<int> Process::run(const std::string& cmd, const Arguments& args, std::string& out)
+inline Expected<int> Process::run(const std::string& cmd, const Arguments& args, std::string& out, int pipeSize)
 {
     Process proc(cmd, args, Capture::Out);
+    proc.setPipeSize(pipeSize);
     if (auto ret = proc.run(); !ret) {
         return unexpected(ret.error());
     }
-    out      = proc.readAllStandardOutput();
-    auto ret = proc.wait();
-    out += proc.readAllStandardOutput();
+    std::string err;
+    out.clear();
+    return proc.drain(out, err);
+}
+
+inline Expected<int> Process::drain(std::string& out, std::string& err)
+{
+    // Both pipes are read from one loop until the end of file, so the child never blocks on a full pipe. A quiet
+    // child is checked for exit, its pipes could be kept open by its own children.
+    while (!readAll(out, err)) {
+        if (auto ret = wait(0); ret || ret.error() != "timeout") {
+            readAll(out, err, 0);
+            if (ret) {
+                return *ret;
+            }
+            return unexpected(ret.error());
+        }
+    }
+
+    auto ret = wait();
     if (ret) {
         return *ret;
     } else {
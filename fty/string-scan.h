@@ -0,0 +1,295 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define FTY_SCAN_X86
+#include <immintrin.h>
+#endif
+
+namespace fty::detail::scan {
+
+// ===========================================================================================================
+
+/// Blocks of 64 bytes are classified at once, the result is a bit mask, bit i is set when byte i matches.
+/// Mask functions take up to 64 bytes, only the scalar ones accept less.
+static constexpr size_t BlockSize = 64;
+
+using ByteMask  = uint64_t (*)(const char* data, size_t size, char ch);
+using SpaceMask = uint64_t (*)(const char* data, size_t size);
+/// Scans the full blocks starting at @ref block. Returns the mask of the first block with a match and sets
+/// @ref block to it, or returns 0 and sets @ref block after the last full block.
+using ByteScan = uint64_t (*)(const char* data, size_t size, char ch, size_t& block);
+
+inline bool isSpace(char ch)
+{
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+inline uint64_t byteMaskScalar(const char* data, size_t size, char ch)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < size; ++i) {
+        mask |= uint64_t(data[i] == ch) << i;
+    }
+    return mask;
+}
+
+inline uint64_t byteScanScalar(const char* data, size_t size, char ch, size_t& block)
+{
+    for (; block + BlockSize <= size; block += BlockSize) {
+        if (uint64_t mask = byteMaskScalar(data + block, BlockSize, ch)) {
+            return mask;
+        }
+    }
+    return 0;
+}
+
+inline uint64_t spaceMaskScalar(const char* data, size_t size)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < size; ++i) {
+        mask |= uint64_t(isSpace(data[i])) << i;
+    }
+    return mask;
+}
+
+#ifdef FTY_SCAN_X86
+
+// SSE2 is part of x86-64, it is always available
+inline uint64_t byteMaskSse2(const char* data, size_t, char ch)
+{
+    const __m128i needle = _mm_set1_epi8(ch);
+
+    uint64_t mask = 0;
+    for (size_t i = 0; i < BlockSize; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        mask |= uint64_t(uint32_t(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)))) << i;
+    }
+    return mask;
+}
+
+inline uint64_t byteScanSse2(const char* data, size_t size, char ch, size_t& block)
+{
+    for (; block + BlockSize <= size; block += BlockSize) {
+        if (uint64_t mask = byteMaskSse2(data + block, BlockSize, ch)) {
+            return mask;
+        }
+    }
+    return 0;
+}
+
+inline uint64_t spaceMaskSse2(const char* data, size_t)
+{
+    uint64_t mask = 0;
+    for (size_t i = 0; i < BlockSize; i += 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        __m128i space = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r'))));
+        mask |= uint64_t(uint32_t(_mm_movemask_epi8(space))) << i;
+    }
+    return mask;
+}
+
+__attribute__((target("avx2"))) inline uint64_t byteMaskAvx2(const char* data, size_t, char ch)
+{
+    const __m256i needle = _mm256_set1_epi8(ch);
+
+    __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    __m256i hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + 32));
+    return uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(lo, needle)))) |
+           (uint64_t(uint32_t(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hi, needle)))) << 32);
+}
+
+__attribute__((target("avx2"))) inline uint64_t byteScanAvx2(const char* data, size_t size, char ch, size_t& block)
+{
+    for (; block + BlockSize <= size; block += BlockSize) {
+        if (uint64_t mask = byteMaskAvx2(data + block, BlockSize, ch)) {
+            return mask;
+        }
+    }
+    return 0;
+}
+
+__attribute__((target("avx2"))) inline uint32_t spaceMaskAvx2Half(const char* data)
+{
+    __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    __m256i space = _mm256_or_si256(
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8(' ')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\t'))),
+        _mm256_or_si256(_mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\n')), _mm256_cmpeq_epi8(chunk, _mm256_set1_epi8('\r'))));
+    return uint32_t(_mm256_movemask_epi8(space));
+}
+
+__attribute__((target("avx2"))) inline uint64_t spaceMaskAvx2(const char* data, size_t)
+{
+    return uint64_t(spaceMaskAvx2Half(data)) | (uint64_t(spaceMaskAvx2Half(data + 32)) << 32);
+}
+
+inline bool hasAvx2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+
+#endif
+
+/// Best implementation for the running CPU, selected once
+inline ByteMask byteMask()
+{
+#ifdef FTY_SCAN_X86
+    static const ByteMask func = hasAvx2() ? &byteMaskAvx2 : &byteMaskSse2;
+    return func;
+#else
+    return &byteMaskScalar;
+#endif
+}
+
+inline ByteScan byteScan()
+{
+#ifdef FTY_SCAN_X86
+    static const ByteScan func = hasAvx2() ? &byteScanAvx2 : &byteScanSse2;
+    return func;
+#else
+    return &byteScanScalar;
+#endif
+}
+
+inline SpaceMask spaceMask()
+{
+#ifdef FTY_SCAN_X86
+    static const SpaceMask func = hasAvx2() ? &spaceMaskAvx2 : &spaceMaskSse2;
+    return func;
+#else
+    return &spaceMaskScalar;
+#endif
+}
+
+// ===========================================================================================================
+
+/// Finds all the positions of one byte in the string, one block at a time.
+/// Positions of the whole block are found in one pass and then consumed from the mask, so the string is read
+/// once, not once per field.
+class ByteScanner
+{
+public:
+    ByteScanner() = default;
+
+    ByteScanner(std::string_view str, char ch)
+        : m_data(str.data())
+        , m_size(str.size())
+        , m_ch(ch)
+        , m_scan(byteScan())
+    {
+        load(0);
+    }
+
+    /// Returns the next position not before @ref from, npos if there is none
+    size_t next(size_t from)
+    {
+        if (from >= m_block + BlockSize) {
+            // Skipped blocks are not scanned at all
+            load(from - from % BlockSize);
+        }
+        if (from > m_block) {
+            m_mask &= ~uint64_t(0) << (from - m_block);
+        }
+
+        if (!m_mask && m_block + BlockSize < m_size) {
+            load(m_block + BlockSize);
+        }
+        if (!m_mask) {
+            return std::string_view::npos;
+        }
+        return m_block + size_t(__builtin_ctzll(m_mask));
+    }
+
+private:
+    /// Loads the first block with a match, starting at @ref block
+    void load(size_t block)
+    {
+        // Blocks without a match are skipped in one call, with no call per block
+        m_mask = m_scan(m_data, m_size, m_ch, block);
+        if (!m_mask && block < m_size) {
+            m_mask = byteMaskScalar(m_data + block, m_size - block, m_ch);
+        }
+        m_block = block;
+    }
+
+private:
+    const char* m_data  = nullptr;
+    size_t      m_size  = 0;
+    char        m_ch    = 0;
+    ByteScan    m_scan  = nullptr;
+    size_t      m_block = 0;
+    uint64_t    m_mask  = 0;
+};
+
+// ===========================================================================================================
+
+/// Returns the position of the first not whitespace character, npos if there is none
+inline size_t firstNotSpace(std::string_view str)
+{
+    // Short fields are the common case, no need to set up the vector path
+    size_t pos = 0;
+    for (; pos < str.size() && pos < 16; ++pos) {
+        if (!isSpace(str[pos])) {
+            return pos;
+        }
+    }
+
+    SpaceMask func = spaceMask();
+    for (; pos < str.size(); pos += BlockSize) {
+        size_t   size = std::min(BlockSize, str.size() - pos);
+        uint64_t mask = size == BlockSize ? func(str.data() + pos, size) : spaceMaskScalar(str.data() + pos, size);
+        uint64_t rest = ~mask & (size == BlockSize ? ~uint64_t(0) : (uint64_t(1) << size) - 1);
+        if (rest) {
+            return pos + size_t(__builtin_ctzll(rest));
+        }
+    }
+    return std::string_view::npos;
+}
+
+/// Returns the position of the last not whitespace character, npos if there is none
+inline size_t lastNotSpace(std::string_view str)
+{
+    size_t end = str.size();
+    for (size_t i = 0; end > 0 && i < 16; ++i, --end) {
+        if (!isSpace(str[end - 1])) {
+            return end - 1;
+        }
+    }
+
+    SpaceMask func = spaceMask();
+    while (end > 0) {
+        size_t   size = std::min(BlockSize, end);
+        size_t   pos  = end - size;
+        uint64_t mask = size == BlockSize ? func(str.data() + pos, size) : spaceMaskScalar(str.data() + pos, size);
+        uint64_t rest = ~mask & (size == BlockSize ? ~uint64_t(0) : (uint64_t(1) << size) - 1);
+        if (rest) {
+            return pos + 63 - size_t(__builtin_clzll(rest));
+        }
+        end = pos;
+    }
+    return std::string_view::npos;
+}
+
+// ===========================================================================================================
+
+} // namespace fty::detail::scan
@@ -15,10 +15,21 @@
 */
 #pragma once
 #include "convert.h"
+#include "expected.h"
 #include "flags.h"
+#include "string-scan.h"
+#include "try-convert.h"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <iterator>
+#include <memory>
+#include <mutex>
 #include <regex>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 namespace fty {
@@ -47,6 +58,22 @@ void trim(std::string& str);
 /// @return trimmed string
 std::string trimmed(const std::string& str);
 
+/// Returns a view that has whitespace removed from the start and the end, nothing is copied.
+/// @param str string to trim
+/// @return trimmed view of str
+std::string_view trimmedView(std::string_view str);
+
+/// Lazy split of the string, see splitView()
+class SplitView;
+
+/// Splits the string into views wherever @ref delim occurs, with the same rules as split(). Views are produced
+/// on demand while iterating and nothing is allocated. Views point to @ref str, which must outlive them.
+/// @param str string to split
+/// @param delim delimeter to split
+/// @param opt split options
+SplitView splitView(
+    std::string_view str, std::string_view delim, SplitOption opt = SplitOption::SkipEmpty | SplitOption::Trim);
+
 /// Splits the string into substrings wherever @ref delim occurs. If @ref delim does not match anywhere in the
 /// string, split() returns a single-element list containing this string.
 /// @param str string to split
@@ -64,6 +91,17 @@ std::vector<std::string> split(
 std::vector<std::string> split(
     const std::string& str, const std::regex& delim, SplitOption opt = SplitOption::SkipEmpty | SplitOption::Trim);
 
+/// Precompiled regular expression to split with, see split(const std::string&, const SplitPattern&, SplitOption)
+class SplitPattern;
+
+/// Splits the string wherever the pattern @ref delim matches, with the same results as the std::regex version.
+/// Common delimiters (`,`, `;+`, `[ \t]+`, `\s+`, ...) are matched without std::regex, by a table of bytes.
+/// @param str string to split
+/// @param delim pattern to split
+/// @param opt split options
+std::vector<std::string> split(
+    const std::string& str, const SplitPattern& delim, SplitOption opt = SplitOption::SkipEmpty | SplitOption::Trim);
+
 /// Splits the string into typed tuple wherever the @ref delim occurs matches. In case if split will produce
 /// less values then tuple size then will contain default values. If split will produce more values, unused
 /// parts will be ingnored
@@ -84,6 +122,25 @@ template <typename... T>
 std::tuple<T...> split(
     const std::string& str, const std::regex& delim, SplitOption opt = SplitOption::KeepEmpty | SplitOption::Trim);
 
+/// Splits the string into typed tuple wherever the pattern @ref delim matches, see the std::regex version
+/// @param str string to split
+/// @param delim pattern to split
+/// @param opt split options
+template <typename... T>
+std::tuple<T...> split(
+    const std::string& str, const SplitPattern& delim, SplitOption opt = SplitOption::KeepEmpty | SplitOption::Trim);
+
+/// Splits the string into typed tuple wherever the @ref delim occurs, like split<T...>, without exceptions.
+/// Fields are parsed straight from the input in one pass, there are no intermediate strings. Missing and empty
+/// fields are default values, unused parts are ignored. A field which is not a whole value of its type (`42 abc`,
+/// `300` for int8_t, `-1` for unsigned) is an error.
+/// @param str string to split
+/// @param delim delimiter to split
+/// @param opt split options
+template <typename... T>
+Expected<std::tuple<T...>> trySplit(
+    std::string_view str, std::string_view delim, SplitOption opt = SplitOption::KeepEmpty | SplitOption::Trim);
+
 /// Converts string to upper case
 /// @param src string to convert
 void toupper(std::string& src);
@@ -94,6 +151,88 @@ void tolower(std::string& src);
 
 // ===========================================================================================================
 
+class SplitView
+{
+public:
+    class Iterator
+    {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type        = std::string_view;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = const std::string_view*;
+        using reference         = const std::string_view&;
+
+        Iterator() = default;
+
+        reference operator*() const;
+        pointer   operator->() const;
+        Iterator& operator++();
+        Iterator  operator++(int);
+        bool      operator==(const Iterator& other) const;
+        bool      operator!=(const Iterator& other) const;
+
+    private:
+        friend class SplitView;
+        explicit Iterator(const SplitView* view);
+        void next();
+
+    private:
+        // Null for the end iterator
+        const SplitView*          m_view = nullptr;
+        size_t                    m_next = 0;
+        std::string_view          m_current;
+        // Vectorized search of one byte delimiter
+        detail::scan::ByteScanner m_scanner;
+    };
+
+public:
+    SplitView(std::string_view str, std::string_view delim, SplitOption opt);
+
+    Iterator begin() const;
+    Iterator end() const;
+
+private:
+    std::string_view m_str;
+    std::string_view m_delim;
+    SplitOption      m_opt;
+};
+
+// ===========================================================================================================
+
+class SplitPattern
+{
+public:
+    /// Compiles ECMAScript regular expression, throws std::regex_error if it is invalid
+    explicit SplitPattern(const std::string& pattern);
+
+    /// Returns compiled pattern from the process wide cache, it is compiled on the first use only
+    static std::shared_ptr<const SplitPattern> cached(const std::string& pattern);
+
+    const std::string& pattern() const;
+
+    /// Returns true if the pattern is matched without std::regex
+    bool isSimple() const;
+
+private:
+    friend std::vector<std::string> split(const std::string& str, const SplitPattern& delim, SplitOption opt);
+
+    bool parseSimple();
+    bool parseClass(std::string_view& pattern);
+
+private:
+    std::string           m_pattern;
+    bool                  m_simple = false;
+    // Simple pattern: one byte of the class, or a run of them if m_repeat
+    std::array<bool, 256> m_class  = {};
+    bool                  m_repeat = false;
+    // The only byte of the class, -1 if there are more
+    int                   m_single = -1;
+    std::regex            m_regex;
+};
+
+// ===========================================================================================================
+
 
 namespace detail {
 
@@ -103,17 +242,47 @@ namespace detail {
         return {convert<T>(Idx < val.size() ? val[Idx] : "")...};
     }
 
-    inline void addString(std::vector<std::string>& ret, SplitOption opt, const std::string& val)
+    template <typename... T, size_t... Idx>
+    Expected<std::tuple<T...>> viewToTuple(
+        std::string_view str, std::string_view delim, SplitOption opt, std::index_sequence<Idx...>)
+    {
+        std::tuple<T...> ret;
+        std::string      error;
+
+        auto range = splitView(str, delim, opt);
+        auto it    = range.begin();
+        auto parse = [&](auto& value, size_t index) {
+            if (it == range.end()) {
+                return true;
+            }
+            std::string_view field = *it;
+            ++it;
+            if (field.empty()) {
+                return true;
+            }
+
+            auto parsed = tryConvert<std::decay_t<decltype(value)>>(field);
+            if (!parsed) {
+                error = fmt::format("Field {} '{}': {}", index, field, parsed.error());
+                return false;
+            }
+            value = std::move(*parsed);
+            return true;
+        };
+
+        if (!(parse(std::get<Idx>(ret), Idx) && ...)) {
+            return unexpected(error);
+        }
+        return ret;
+    }
+
+    inline void addString(std::vector<std::string>& ret, SplitOption opt, std::string_view val)
     {
         if (isSet(opt, SplitOption::SkipEmpty) && val.empty()) {
             return;
         }
 
-        if (isSet(opt, SplitOption::Trim)) {
-            ret.push_back(trimmed(val));
-        } else {
-            ret.push_back(val);
-        }
+        ret.emplace_back(isSet(opt, SplitOption::Trim) ? trimmedView(val) : val);
     }
 
 } // namespace detail
@@ -132,21 +301,26 @@ inline std::string trimmed(const std::string& str)
     return ret;
 }
 
-inline std::vector<std::string> split(const std::string& str, const std::string& delim, SplitOption opt)
+inline std::string_view trimmedView(std::string_view str)
 {
-    size_t                   pos   = 0;
-    size_t                   begin = 0;
-    std::vector<std::string> ret;
-
-    while ((pos = str.find(delim, begin)) != std::string::npos) {
-        detail::addString(ret, opt, str.substr(begin, pos - begin));
-        begin = pos + 1;
+    size_t first = detail::scan::firstNotSpace(str);
+    if (first == std::string_view::npos) {
+        return str.substr(str.size());
     }
+    return str.substr(first, detail::scan::lastNotSpace(str) - first + 1);
+}
 
-    if (begin < str.size()) {
-        detail::addString(ret, opt, str.substr(begin, str.size() - begin));
-    }
+inline SplitView splitView(std::string_view str, std::string_view delim, SplitOption opt)
+{
+    return SplitView(str, delim, opt);
+}
 
+inline std::vector<std::string> split(const std::string& str, const std::string& delim, SplitOption opt)
+{
+    std::vector<std::string> ret;
+    for (std::string_view part : splitView(str, delim, opt)) {
+        ret.emplace_back(part);
+    }
     return ret;
 }
 
@@ -157,7 +331,7 @@ inline std::vector<std::string> split(const std::string& str, const std::regex&
         std::sregex_token_iterator iter(str.begin(), str.end(), delim, -1);
         std::sregex_token_iterator end;
         for (; iter != end; ++iter) {
-            detail::addString(ret, opt, *iter);
+            detail::addString(ret, opt, std::string_view(str.data() + (iter->first - str.begin()), size_t(iter->length())));
         }
     } else {
         std::vector<int> submatches;
@@ -167,7 +341,7 @@ inline std::vector<std::string> split(const std::string& str, const std::regex&
         std::sregex_token_iterator iter(str.begin(), str.end(), delim, submatches);
         std::sregex_token_iterator end;
         for (; iter != end; ++iter) {
-            detail::addString(ret, opt, *iter);
+            detail::addString(ret, opt, std::string_view(str.data() + (iter->first - str.begin()), size_t(iter->length())));
         }
     }
     return ret;
@@ -185,6 +359,320 @@ std::tuple<T...> split(const std::string& str, const std::regex& delim, SplitOpt
     return detail::vectorToTuple<T...>(split(str, delim, opt), std::make_index_sequence<sizeof...(T)>());
 }
 
+inline std::vector<std::string> split(const std::string& str, const SplitPattern& delim, SplitOption opt)
+{
+    if (!delim.m_simple) {
+        return split(str, delim.m_regex, opt);
+    }
+
+    // Single byte delimiter is searched by blocks, as in splitView
+    detail::scan::ByteScanner scanner;
+    if (delim.m_single >= 0) {
+        scanner = detail::scan::ByteScanner(str, char(delim.m_single));
+    }
+
+    // Same as sregex_token_iterator: text before every match, then the rest if it is not empty or nothing matched
+    std::vector<std::string> ret;
+    size_t                   begin   = 0;
+    bool                     matched = false;
+    for (size_t pos = 0; pos < str.size();) {
+        if (delim.m_single >= 0) {
+            if ((pos = scanner.next(pos)) == std::string_view::npos) {
+                break;
+            }
+        } else if (!delim.m_class[uint8_t(str[pos])]) {
+            ++pos;
+            continue;
+        }
+        detail::addString(ret, opt, std::string_view(str).substr(begin, pos - begin));
+        ++pos;
+        while (delim.m_repeat && pos < str.size() && delim.m_class[uint8_t(str[pos])]) {
+            ++pos;
+        }
+        begin   = pos;
+        matched = true;
+    }
+    if (begin < str.size() || !matched) {
+        detail::addString(ret, opt, std::string_view(str).substr(begin));
+    }
+    return ret;
+}
+
+template <typename... T>
+std::tuple<T...> split(const std::string& str, const SplitPattern& delim, SplitOption opt)
+{
+    return detail::vectorToTuple<T...>(split(str, delim, opt), std::make_index_sequence<sizeof...(T)>());
+}
+
+template <typename... T>
+Expected<std::tuple<T...>> trySplit(std::string_view str, std::string_view delim, SplitOption opt)
+{
+    return detail::viewToTuple<T...>(str, delim, opt, std::make_index_sequence<sizeof...(T)>());
+}
+
+// ===========================================================================================================
+
+inline SplitPattern::SplitPattern(const std::string& pattern)
+    : m_pattern(pattern)
+{
+    m_simple = parseSimple();
+    if (!m_simple) {
+        m_regex = std::regex(pattern);
+    }
+}
+
+inline std::shared_ptr<const SplitPattern> SplitPattern::cached(const std::string& pattern)
+{
+    static std::mutex                                                           mutex;
+    static std::unordered_map<std::string, std::shared_ptr<const SplitPattern>> cache;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (auto it = cache.find(pattern); it != cache.end()) {
+        return it->second;
+    }
+
+    // Patterns built at runtime should not grow the cache forever, users keep their shared pointers
+    if (cache.size() >= 1024) {
+        cache.clear();
+    }
+    auto compiled = std::make_shared<const SplitPattern>(pattern);
+    cache.emplace(pattern, compiled);
+    return compiled;
+}
+
+inline const std::string& SplitPattern::pattern() const
+{
+    return m_pattern;
+}
+
+inline bool SplitPattern::isSimple() const
+{
+    return m_simple;
+}
+
+inline bool SplitPattern::parseSimple()
+{
+    // One of: X, X+ where X is a character, an escape or a bracket expression
+    std::string_view pattern = m_pattern;
+    if (!parseClass(pattern)) {
+        return false;
+    }
+    if (pattern == "+") {
+        m_repeat = true;
+        pattern.remove_prefix(1);
+    }
+    if (!pattern.empty()) {
+        return false;
+    }
+
+    if (std::count(m_class.begin(), m_class.end(), true) == 1) {
+        m_single = int(std::find(m_class.begin(), m_class.end(), true) - m_class.begin());
+    }
+    return true;
+}
+
+inline bool SplitPattern::parseClass(std::string_view& pattern)
+{
+    static constexpr std::string_view special = "^$\\.*+?()[]{}|";
+
+    auto escape = [&](char ch, std::array<bool, 256>& cls) {
+        switch (ch) {
+            case 's':
+                for (char sp : {' ', '\t', '\n', '\v', '\f', '\r'}) {
+                    cls[uint8_t(sp)] = true;
+                }
+                return true;
+            case 'd':
+                for (char dig = '0'; dig <= '9'; ++dig) {
+                    cls[uint8_t(dig)] = true;
+                }
+                return true;
+            case 't':
+                cls[uint8_t('\t')] = true;
+                return true;
+            case 'n':
+                cls[uint8_t('\n')] = true;
+                return true;
+            case 'r':
+                cls[uint8_t('\r')] = true;
+                return true;
+            default:
+                // Escaped punctuation is the character itself, letters and digits have special meanings
+                if (std::ispunct(uint8_t(ch))) {
+                    cls[uint8_t(ch)] = true;
+                    return true;
+                }
+                return false;
+        }
+    };
+
+    if (pattern.empty()) {
+        return false;
+    }
+
+    if (pattern[0] == '\\') {
+        if (pattern.size() < 2 || !escape(pattern[1], m_class)) {
+            return false;
+        }
+        pattern.remove_prefix(2);
+        return true;
+    }
+
+    if (pattern[0] != '[') {
+        if (special.find(pattern[0]) != std::string_view::npos) {
+            return false;
+        }
+        m_class[uint8_t(pattern[0])] = true;
+        pattern.remove_prefix(1);
+        return true;
+    }
+
+    // Bracket expression with characters, ranges and escapes, optionally negated
+    size_t pos    = 1;
+    bool   negate = pos < pattern.size() && pattern[pos] == '^';
+    if (negate) {
+        ++pos;
+    }
+
+    std::array<bool, 256> cls = {};
+    bool                  any = false;
+    while (pos < pattern.size() && pattern[pos] != ']') {
+        char ch = pattern[pos];
+        if (ch == '[') {
+            // Character classes as [:alpha:], left to std::regex
+            return false;
+        }
+        if (ch == '\\') {
+            if (pos + 1 >= pattern.size() || !escape(pattern[pos + 1], cls)) {
+                return false;
+            }
+            pos += 2;
+        } else if (pos + 2 < pattern.size() && pattern[pos + 1] == '-' && pattern[pos + 2] != ']') {
+            char last = pattern[pos + 2];
+            if (last == '\\' || last == '[' || uint8_t(last) < uint8_t(ch)) {
+                return false;
+            }
+            for (int c = uint8_t(ch); c <= uint8_t(last); ++c) {
+                cls[size_t(c)] = true;
+            }
+            pos += 3;
+        } else {
+            cls[uint8_t(ch)] = true;
+            ++pos;
+        }
+        any = true;
+    }
+
+    if (pos >= pattern.size() || !any) {
+        return false;
+    }
+
+    for (size_t i = 0; i < cls.size(); ++i) {
+        m_class[i] = cls[i] != negate;
+    }
+    pattern.remove_prefix(pos + 1);
+    return true;
+}
+
+// ===========================================================================================================
+
+inline SplitView::SplitView(std::string_view str, std::string_view delim, SplitOption opt)
+    : m_str(str)
+    , m_delim(delim)
+    , m_opt(opt)
+{
+}
+
+inline SplitView::Iterator SplitView::begin() const
+{
+    return Iterator(this);
+}
+
+inline SplitView::Iterator SplitView::end() const
+{
+    return Iterator();
+}
+
+inline SplitView::Iterator::Iterator(const SplitView* view)
+    : m_view(view)
+{
+    if (view->m_delim.size() == 1) {
+        m_scanner = detail::scan::ByteScanner(view->m_str, view->m_delim[0]);
+    }
+    next();
+}
+
+inline void SplitView::Iterator::next()
+{
+    const std::string_view& str = m_view->m_str;
+    while (true) {
+        if (m_next == std::string_view::npos || m_next >= str.size()) {
+            // Nothing after the last delimiter is not an empty field
+            *this = Iterator();
+            return;
+        }
+
+        size_t pos = std::string_view::npos;
+        if (m_view->m_delim.size() == 1) {
+            pos = m_scanner.next(m_next);
+        } else if (!m_view->m_delim.empty()) {
+            pos = str.find(m_view->m_delim, m_next);
+        }
+
+        std::string_view field;
+        if (pos == std::string_view::npos) {
+            field  = str.substr(m_next);
+            m_next = std::string_view::npos;
+        } else {
+            field  = str.substr(m_next, pos - m_next);
+            m_next = pos + m_view->m_delim.size();
+        }
+
+        // Emptiness is checked before trimming, as in split()
+        if (isSet(m_view->m_opt, SplitOption::SkipEmpty) && field.empty()) {
+            continue;
+        }
+
+        m_current = isSet(m_view->m_opt, SplitOption::Trim) ? trimmedView(field) : field;
+        return;
+    }
+}
+
+inline SplitView::Iterator::reference SplitView::Iterator::operator*() const
+{
+    return m_current;
+}
+
+inline SplitView::Iterator::pointer SplitView::Iterator::operator->() const
+{
+    return &m_current;
+}
+
+inline SplitView::Iterator& SplitView::Iterator::operator++()
+{
+    next();
+    return *this;
+}
+
+inline SplitView::Iterator SplitView::Iterator::operator++(int)
+{
+    Iterator tmp = *this;
+    next();
+    return tmp;
+}
+
+inline bool SplitView::Iterator::operator==(const Iterator& other) const
+{
+    return m_view == other.m_view && m_next == other.m_next && m_current.data() == other.m_current.data();
+}
+
+inline bool SplitView::Iterator::operator!=(const Iterator& other) const
+{
+    return !(*this == other);
+}
+
+// ===========================================================================================================
+
 template <typename Cnt>
 std::string implode(const Cnt& cnt, const std::string& delim)
 {
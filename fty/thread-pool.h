@@ -66,6 +66,10 @@ public:
     size_t getCountPendingTasks() noexcept;
     size_t getCountActiveTasks() noexcept;
 
+    /// Returns executor which pushes jobs to this pool, to be used with queued slots.
+    /// Executor could outlive the pool: jobs posted after the pool destruction started are dropped.
+    Executor executor();
+
 private:
     void init();
     void taskRunner();
@@ -73,10 +77,26 @@ private:
 
     void waitEndAllthreads() noexcept; // Used in waitUntilStopped and ~ThreadPool
 
+private:
+    /// Shared with the executors, tells them if the pool is still alive
+    struct Owner
+    {
+        explicit Owner(ThreadPool* owner)
+            : pool(owner)
+        {
+        }
+
+        std::mutex  mutex;
+        ThreadPool* pool;
+    };
+
 private:
     const size_t m_minNumThreads;
     const size_t m_maxNumThreads;
 
+    // Executors keep weak reference to it
+    std::shared_ptr<Owner> m_owner = std::make_shared<Owner>(this);
+
     // List of threads in the pool
     std::vector<std::thread> m_threads;
     std::atomic<size_t>      m_countThreads = 0;
@@ -203,6 +223,12 @@ inline void ThreadPool::init()
 
 inline ThreadPool::~ThreadPool()
 {
+    // Executors still referenced by connections must not touch the pool from now on
+    {
+        std::lock_guard<std::mutex> lock(m_owner->mutex);
+        m_owner->pool = nullptr;
+    }
+
     // Do not start any new task, and wait to have the current one stopped
     requestStop(Stop::Immedialy);
     waitEndAllthreads();
@@ -233,7 +259,7 @@ std::shared_ptr<ITask> ThreadPool::pushWorker(Func&& fnc, Args&&... args)
     task = std::make_shared<details::GenericTask>(std::move(fnc), std::forward<Args>(args)...);
 
     addTask(task);
-    return std::move(task);
+    return task;
 }
 
 inline void ThreadPool::addTask(std::shared_ptr<ITask> task)
@@ -275,6 +301,18 @@ inline void ThreadPool::addTask(std::shared_ptr<ITask> task)
     m_cvTasks.notify_one();
 }
 
+inline Executor ThreadPool::executor()
+{
+    return [owner = std::weak_ptr<Owner>(m_owner)](std::function<void()> job) {
+        if (auto alive = owner.lock()) {
+            std::lock_guard<std::mutex> lock(alive->mutex);
+            if (alive->pool) {
+                alive->pool->pushWorker(std::move(job));
+            }
+        }
+    };
+}
+
 inline size_t ThreadPool::getCountPendingTasks() noexcept
 {
     // We need to count the threads
@@ -16,9 +16,13 @@
 #pragma once
 
 #include "fty/event.h"
+#include "fty/histogram.h"
+#include <algorithm>
 #include <atomic>
+#include <condition_variable>
 #include <functional>
 #include <map>
+#include <mutex>
 #include <thread>
 
 namespace fty {
@@ -28,6 +32,28 @@ namespace details {
     class RepeatableImpl;
 } // namespace details
 
+/// Timers statistics, collected only if enabled by Timer::enableStatistics()
+struct TimerStatistics
+{
+    /// Callback execution statistics for one label
+    struct Callback
+    {
+        std::string               label;
+        uint64_t                  calls = 0;
+        std::chrono::microseconds total = std::chrono::microseconds::zero();
+        std::chrono::microseconds max   = std::chrono::microseconds::zero();
+    };
+
+    /// Difference between real fire time and planned one
+    Histogram::Snapshot lateness;
+    /// Callbacks execution time
+    Histogram::Snapshot execution;
+    /// Number of currently active timers
+    size_t activeTimers = 0;
+    /// Timer thread wake-ups per second since statistics were enabled
+    double wakeupsPerSecond = 0;
+};
+
 /// Simple timer implemenatation.
 /// Please, do not use long term functions as timer callback
 class Timer
@@ -43,6 +69,8 @@ public:
     /// Stops the timer
     /// @note Do not call in callback function
     void stop();
+    /// Sets the label of the timer, used to group callbacks in statistics
+    void setLabel(const std::string& label);
 
 public:
     /// Finish event
@@ -81,6 +109,16 @@ public:
     template <typename Rep, typename Period, typename Func, typename Cls>
     static Timer repeatable(const std::chrono::duration<Rep, Period>& interval, Func&& func, Cls* cls);
 
+public:
+    /// Enables (and resets) or disables timers statistics collection
+    static void enableStatistics(bool enable = true);
+
+    /// Returns collected timers statistics
+    static TimerStatistics statistics();
+
+    /// Returns @ref count slowest callbacks (by maximum execution time) grouped by label
+    static std::vector<TimerStatistics::Callback> slowestCallbacks(size_t count = 10);
+
 private:
     Timer(uint64_t timerId);
     void triggerFinish(uint64_t timerId);
@@ -89,8 +127,9 @@ private:
     friend class details::RepeatableImpl;
     static details::TimersHolder& holder();
 
-    Slot<uint64_t> onFinish  = {&Timer::triggerFinish, this};
-    uint64_t       m_timerId = 0;
+    Slot<uint64_t>   onFinish  = {&Timer::triggerFinish, this};
+    uint64_t         m_timerId = 0;
+    ScopedConnection m_finishConnection;
 };
 
 // =========================================================================================================================================
@@ -111,6 +150,11 @@ namespace details {
         void        stopTimer(uint64_t timerId);
         void        stop();
         TimerImpl*  timer(uint64_t timerId);
+        void        setLabel(uint64_t timerId, const std::string& label);
+
+        void                                   enableStatistics(bool enable);
+        TimerStatistics                        statistics() const;
+        std::vector<TimerStatistics::Callback> slowestCallbacks(size_t count) const;
 
         Event<uint64_t> timerFinished;
 
@@ -118,16 +162,29 @@ namespace details {
         void calcNextTimeout();
         void worker();
         void removeTimer(uint64_t timerId);
+        void fire(uint64_t timerId);
 
     private:
-        std::thread                                    m_thread;
-        std::map<uint64_t, std::unique_ptr<TimerImpl>> m_timers;
-        std::condition_variable                        m_cv;
-        std::atomic<bool>                              m_running     = true;
-        std::atomic<bool>                              m_nextChanged = false;
-        std::mutex                                     m_mutex;
-        std::chrono::steady_clock::time_point          m_nextTimeout;
-        uint64_t                                       m_currentTimer = 0;
+        std::map<uint64_t, std::unique_ptr<TimerImpl>>   m_timers;
+        std::condition_variable                          m_cv;
+        std::atomic<bool>                                m_running     = true;
+        std::atomic<bool>                                m_nextChanged = false;
+        std::mutex                                       m_mutex;
+        std::chrono::steady_clock::time_point            m_nextTimeout;
+        uint64_t                                         m_currentTimer = 0;
+        std::atomic<size_t>                              m_activeTimers = 0;
+
+        // Statistics, touched by the timer thread only when m_statsEnabled is set
+        std::atomic<bool>                                m_statsEnabled = false;
+        Histogram                                        m_lateness;
+        Histogram                                        m_execution;
+        std::atomic<uint64_t>                            m_wakeups = 0;
+        mutable std::mutex                               m_statsMutex;
+        std::chrono::steady_clock::time_point            m_statsSince;
+        std::map<std::string, TimerStatistics::Callback> m_callbacks;
+
+        // Started last, the worker uses all the members above
+        std::thread                                      m_thread;
     };
 
     class TimerImpl
@@ -146,9 +203,20 @@ namespace details {
             return m_point + m_interval;
         }
 
+        const std::string& label() const
+        {
+            return m_label;
+        }
+
+        void setLabel(const std::string& label)
+        {
+            m_label = label;
+        }
+
     protected:
         std::chrono::milliseconds             m_interval;
         std::chrono::steady_clock::time_point m_point;
+        std::string                           m_label;
     };
 
     class SingleShotImpl : public TimerImpl
@@ -215,6 +283,7 @@ inline uint64_t details::TimersHolder::addTimer(std::unique_ptr<TimerImpl>&& tim
     {
         std::lock_guard<std::mutex> lock(m_mutex);
         m_timers.emplace(++id, std::move(timer));
+        m_activeTimers = m_timers.size();
         calcNextTimeout();
     }
     m_cv.notify_all();
@@ -266,34 +335,68 @@ inline void details::TimersHolder::worker()
             return;
         }
 
+        if (m_statsEnabled) {
+            ++m_wakeups;
+        }
+
         if (m_nextChanged) {
             m_nextChanged = false;
             continue;
         }
 
         if (isActive(m_currentTimer)) {
-            if (auto st = dynamic_cast<SingleShotImpl*>(m_timers[m_currentTimer].get())) {
-                st->timeout();
-                removeTimer(m_currentTimer);
-            } else if (auto rt = dynamic_cast<RepeatableImpl*>(m_timers[m_currentTimer].get())) {
-                bool result = false;
-                rt->timeout(result);
-                if (!result) {
-                    removeTimer(m_currentTimer);
-                }
-            }
+            fire(m_currentTimer);
         }
 
         calcNextTimeout();
     }
 }
 
+inline void details::TimersHolder::fire(uint64_t timerId)
+{
+    TimerImpl* timer = m_timers[timerId].get();
+    bool       stats = m_statsEnabled;
+    auto       start = std::chrono::steady_clock::now();
+
+    if (stats) {
+        m_lateness.add(start - timer->nextFireTime());
+    }
+
+    bool finished = true;
+    if (auto st = dynamic_cast<SingleShotImpl*>(timer)) {
+        st->timeout();
+    } else if (auto rt = dynamic_cast<RepeatableImpl*>(timer)) {
+        bool result = false;
+        rt->timeout(result);
+        finished = !result;
+    }
+
+    if (stats) {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+        m_execution.add(elapsed);
+
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        std::string                 label = timer->label().empty() ? "unnamed" : timer->label();
+
+        auto& cb = m_callbacks[label];
+        cb.label = label;
+        cb.calls++;
+        cb.total += elapsed;
+        cb.max = std::max(cb.max, elapsed);
+    }
+
+    if (finished) {
+        removeTimer(timerId);
+    }
+}
+
 inline void details::TimersHolder::stop()
 {
     {
         std::lock_guard<std::mutex> lock(m_mutex);
         m_running = false;
         m_timers.clear();
+        m_activeTimers = 0;
     }
     m_cv.notify_all();
     m_thread.join();
@@ -314,6 +417,7 @@ inline void details::TimersHolder::removeTimer(uint64_t timerId)
     if (m_timers.count(timerId)) {
         // m_timers[timerId]->finish();
         m_timers.erase(timerId);
+        m_activeTimers = m_timers.size();
         timerFinished(std::move(timerId));
     }
 }
@@ -334,6 +438,65 @@ inline bool details::TimersHolder::isRepeatable(uint64_t timerId) const
     return false;
 }
 
+inline void details::TimersHolder::setLabel(uint64_t timerId, const std::string& label)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (auto it = m_timers.find(timerId); it != m_timers.end()) {
+        it->second->setLabel(label);
+    }
+}
+
+inline void details::TimersHolder::enableStatistics(bool enable)
+{
+    if (enable) {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_lateness.reset();
+        m_execution.reset();
+        m_wakeups    = 0;
+        m_statsSince = std::chrono::steady_clock::now();
+        m_callbacks.clear();
+    }
+    m_statsEnabled = enable;
+}
+
+inline TimerStatistics details::TimersHolder::statistics() const
+{
+    TimerStatistics stats;
+    stats.lateness     = m_lateness.snapshot();
+    stats.execution    = m_execution.snapshot();
+    stats.activeTimers = m_activeTimers;
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    if (m_statsEnabled) {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_statsSince;
+        if (elapsed.count() > 0) {
+            stats.wakeupsPerSecond = double(m_wakeups) / elapsed.count();
+        }
+    }
+    return stats;
+}
+
+inline std::vector<TimerStatistics::Callback> details::TimersHolder::slowestCallbacks(size_t count) const
+{
+    std::vector<TimerStatistics::Callback> ret;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        ret.reserve(m_callbacks.size());
+        for (const auto& [label, cb] : m_callbacks) {
+            ret.push_back(cb);
+        }
+    }
+
+    std::sort(ret.begin(), ret.end(), [](const auto& l, const auto& r) {
+        return l.max > r.max;
+    });
+
+    if (ret.size() > count) {
+        ret.resize(count);
+    }
+    return ret;
+}
+
 // =========================================================================================================================================
 
 inline details::TimersHolder& Timer::holder()
@@ -413,19 +576,19 @@ inline void Timer::stop()
 inline Timer::Timer(uint64_t timerId)
     : m_timerId(timerId)
 {
-    onFinish.connect(holder().timerFinished);
+    m_finishConnection = onFinish.connect(holder().timerFinished);
 }
 
 inline Timer::Timer(const Timer& other)
     : m_timerId(other.m_timerId)
 {
-    onFinish.connect(holder().timerFinished);
+    m_finishConnection = onFinish.connect(holder().timerFinished);
 }
 
 inline Timer& Timer::operator=(const Timer& other)
 {
     m_timerId = other.m_timerId;
-    onFinish.connect(holder().timerFinished);
+    m_finishConnection = onFinish.connect(holder().timerFinished);
     return *this;
 }
 
@@ -441,6 +604,26 @@ inline bool Timer::isRepeatable() const
     return holder().isRepeatable(m_timerId);
 }
 
+inline void Timer::setLabel(const std::string& label)
+{
+    holder().setLabel(m_timerId, label);
+}
+
+inline void Timer::enableStatistics(bool enable)
+{
+    holder().enableStatistics(enable);
+}
+
+inline TimerStatistics Timer::statistics()
+{
+    return holder().statistics();
+}
+
+inline std::vector<TimerStatistics::Callback> Timer::slowestCallbacks(size_t count)
+{
+    return holder().slowestCallbacks(count);
+}
+
 // =========================================================================================================================================
 
 } // namespace fty
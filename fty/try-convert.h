@@ -0,0 +1,62 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#pragma once
+#include "convert.h"
+#include "expected.h"
+#include <charconv>
+#include <exception>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace fty {
+
+/// Converts the string to the value without exceptions. The whole string must be a value of the type: spaces or
+/// other text around a number, numbers out of the type range and negative values of unsigned types are errors.
+/// Types with own convert() specialization are converted by it, its exceptions are returned as errors.
+template <typename T>
+Expected<T> tryConvert(std::string_view value)
+{
+    if constexpr (std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>) {
+        return T(value);
+    } else if constexpr (std::is_same_v<T, bool>) {
+        if (value == "1" || value == "true") {
+            return true;
+        }
+        if (value == "0" || value == "false") {
+            return false;
+        }
+        return unexpected("not a boolean");
+    } else if constexpr (std::is_integral_v<T> || std::is_floating_point_v<T>) {
+        T    result{};
+        auto ret = detail::fromChars(value, result);
+        if (ret.ec == std::errc::result_out_of_range) {
+            return unexpected("out of range");
+        }
+        if (ret.ec != std::errc() || ret.ptr != value.data() + value.size()) {
+            return unexpected("not a number");
+        }
+        return result;
+    } else {
+        try {
+            return convert<T>(std::string(value));
+        } catch (const std::exception& e) {
+            return unexpected(e.what());
+        }
+    }
+}
+
+} // namespace fty
@@ -14,7 +14,13 @@
     ========================================================================
 */
 #include "fty/convert.h"
+#include "fty/try-convert.h"
+#include "fty/translate.h"
 #include <catch2/catch.hpp>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <limits>
 
 using namespace Catch::literals;
 
@@ -28,6 +34,10 @@ TEST_CASE("Convert")
     CHECK("11" == fty::convert<std::string>(11ul));
     CHECK("str" == fty::convert<std::string>("str"));
 
+    // Types converting to std::string only
+    CHECK(42 == fty::convert<int>(fty::Translate("42")));
+    CHECK("str" == fty::convert<std::string>(fty::Translate("str")));
+
     CHECK(32 == fty::convert<int>(32.222));
     CHECK(1 == fty::convert<int>(true));
 
@@ -53,6 +63,92 @@ TEST_CASE("Convert")
     CHECK(42.22_a == fty::convert<double>("42.22"));
 }
 
+TEST_CASE("Convert range")
+{
+    CHECK(-128 == fty::convert<int8_t>("-128"));
+    CHECK_THROWS_AS(fty::convert<int8_t>("128"), std::out_of_range);
+    CHECK_THROWS_AS(fty::convert<uint8_t>("256"), std::out_of_range);
+    CHECK_THROWS_AS(fty::convert<uint16_t>("-1"), std::out_of_range);
+    CHECK_THROWS_AS(fty::convert<int64_t>("9223372036854775808"), std::out_of_range);
+    CHECK_THROWS_AS(fty::convert<double>("1e999"), std::out_of_range);
+    CHECK_THROWS_AS(fty::convert<int>("abc"), std::invalid_argument);
+
+    // As std::stoi, spaces before the number and text after it are accepted
+    CHECK(42 == fty::convert<int>("  42 volts"));
+    CHECK(42 == fty::convert<int>("+42"));
+    CHECK(0.5_a == fty::convert<double>(" 0.5"));
+    CHECK(0 == fty::convert<int>(std::string_view()));
+}
+
+TEST_CASE("Try convert")
+{
+    CHECK(*fty::tryConvert<int8_t>("-128") == -128);
+    CHECK(*fty::tryConvert<uint64_t>("18446744073709551615") == std::numeric_limits<uint64_t>::max());
+    CHECK(*fty::tryConvert<int>("+7") == 7);
+    CHECK(*fty::tryConvert<double>("-12.5") == -12.5);
+    CHECK(*fty::tryConvert<bool>("false") == false);
+    CHECK(*fty::tryConvert<std::string>("str") == "str");
+
+    auto range = fty::tryConvert<int8_t>("200");
+    REQUIRE_FALSE(range);
+    CHECK(range.error() == "out of range");
+
+    auto garbage = fty::tryConvert<int>("42 volts");
+    REQUIRE_FALSE(garbage);
+    CHECK(garbage.error() == "not a number");
+
+    CHECK_FALSE(fty::tryConvert<uint32_t>("-1"));
+    CHECK_FALSE(fty::tryConvert<int>(""));
+    CHECK_FALSE(fty::tryConvert<int>(" 1"));
+    CHECK_FALSE(fty::tryConvert<float>("1e99"));
+    CHECK_FALSE(fty::tryConvert<bool>("yes"));
+}
+
+TEST_CASE("Convert float round trip")
+{
+    CHECK("0.1" == fty::convert<std::string>(0.1));
+    CHECK("1234567" == fty::convert<std::string>(1234567.0));
+    CHECK("-0.25" == fty::convert<std::string>(-0.25f));
+
+    for (double value : {0.1, 1.0 / 3, 2.5e-300, 123456.789, -1e21, std::nextafter(1.0, 2.0)}) {
+        CHECK(value == fty::convert<double>(fty::convert<std::string>(value)));
+    }
+    for (float value : {0.1f, 1.0f / 3, 3.4e38f}) {
+        CHECK(value == fty::convert<float>(fty::convert<std::string>(value)));
+    }
+}
+
+TEST_CASE("Convert throughput", "[.][benchmark]")
+{
+    std::vector<std::string> values;
+    for (int i = 0; i < 1000000; ++i) {
+        values.push_back(std::to_string(i * 0.37));
+    }
+
+    auto measure = [&](const char* name, auto&& func) {
+        auto   start = std::chrono::steady_clock::now();
+        double sum   = 0;
+        for (const auto& value : values) {
+            sum += func(value);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << double(values.size()) / elapsed.count() / 1e6 << " M values/s (" << sum << ")" << std::endl;
+    };
+
+    measure("std::stod", [](const std::string& value) {
+        return std::stod(value);
+    });
+    measure("convert<double>", [](const std::string& value) {
+        return fty::convert<double>(value);
+    });
+    measure("tryConvert<double>", [](const std::string& value) {
+        return *fty::tryConvert<double>(value);
+    });
+    measure("convert<std::string>", [](const std::string& value) {
+        return double(fty::convert<std::string>(double(value.size()) * 0.37).size());
+    });
+}
+
 enum class Test
 {
     One,
@@ -0,0 +1,171 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#include "fty/event-bus.h"
+#include <catch2/catch.hpp>
+#include <thread>
+
+TEST_CASE("EventBus")
+{
+    fty::EventBus<int> bus;
+
+    auto load  = bus.topic("metrics/ups-1/load");
+    auto temp  = bus.topic("metrics/ups-1/temperature");
+    auto load2 = bus.topic("metrics/ups-2/load");
+
+    CHECK(bus.topic("metrics/ups-1/load") == load);
+    CHECK(bus.name(temp) == "metrics/ups-1/temperature");
+    CHECK(bus.name(fty::EventBus<int>::InvalidTopic).empty());
+    CHECK(bus.size() == 3);
+
+    int loadSum = 0;
+    int tempSum = 0;
+    int allSum  = 0;
+
+    fty::Slot<int> loadSlot([&](int val) {
+        loadSum += val;
+    });
+    fty::Slot<int> tempSlot([&](int val) {
+        tempSum += val;
+    });
+    fty::Slot<int> allSlot([&](int val) {
+        allSum += val;
+    });
+
+    auto conn = bus.subscribe(temp, tempSlot);
+    bus.subscribe("metrics/*/load", loadSlot);
+    bus.subscribe("metrics/*", allSlot);
+
+    bus.publish(load, 1);
+    bus.publish(temp, 10);
+    bus.publish(load2, 100);
+
+    CHECK(loadSum == 101);
+    CHECK(tempSum == 10);
+    CHECK(allSum == 111);
+
+    SECTION("Wildcard on new topic")
+    {
+        auto load3 = bus.topic("metrics/ups-3/load");
+        bus.publish(load3, 1000);
+        CHECK(loadSum == 1101);
+        CHECK(allSum == 1111);
+    }
+
+    SECTION("Unsubscribe")
+    {
+        conn.disconnect();
+        bus.publish(temp, 10);
+        CHECK(tempSum == 10);
+        CHECK(allSum == 121);
+    }
+
+    SECTION("Unsubscribe wildcard")
+    {
+        fty::Slot<int> upsSlot([&](int val) {
+            allSum += val;
+        });
+        fty::Connection ups = bus.subscribe("metrics/ups-1/*", upsSlot);
+        CHECK(ups.isConnected());
+        bus.publish(load, 1);
+        CHECK(allSum == 113);
+
+        ups.disconnect();
+        CHECK_FALSE(ups.isConnected());
+        bus.publish(load, 1);
+        CHECK(allSum == 114);
+
+        // Not connected to new topics either
+        auto fan = bus.topic("metrics/ups-1/fan");
+        bus.publish(fan, 1000);
+        CHECK(allSum == 1114);
+    }
+
+    SECTION("Scoped wildcard")
+    {
+        {
+            fty::ScopedConnection scoped = bus.subscribe("metrics/*/load", tempSlot);
+            bus.publish(load, 1);
+            CHECK(tempSum == 11);
+        }
+        bus.publish(load, 1);
+        CHECK(tempSum == 11);
+    }
+
+    SECTION("Ended wildcards are dropped")
+    {
+        size_t before = bus.wildcards();
+        for (int i = 0; i < 1000; ++i) {
+            fty::Slot<int> tmp([](int) {});
+            fty::ScopedConnection scoped = bus.subscribe("metrics/*", tmp);
+            bus.subscribe("metrics/*", tmp).disconnect();
+        }
+        // Only the subscriptions made since the last cleanup are kept, no new topic is needed
+        CHECK(bus.wildcards() <= before + 2);
+    }
+
+    SECTION("Expired wildcard slot")
+    {
+        int calls = 0;
+        {
+            fty::Slot<int> tmp([&](int) {
+                ++calls;
+            });
+            bus.subscribe("status/*", tmp);
+        }
+        auto status = bus.topic("status/ups-1");
+        bus.publish(status, 1);
+        CHECK(calls == 0);
+    }
+}
+
+TEST_CASE("EventBus concurrent")
+{
+    fty::EventBus<int> bus;
+    std::atomic<int>   sum = 0;
+
+    fty::Slot<int> slot([&](int val) {
+        sum += val;
+    });
+    bus.subscribe("*", slot);
+
+    auto first = bus.topic("topic-0");
+
+    std::thread creator([&]() {
+        for (int i = 1; i < 2000; ++i) {
+            bus.topic("topic-" + std::to_string(i));
+        }
+    });
+
+    std::vector<std::thread> publishers;
+    for (int i = 0; i < 4; ++i) {
+        publishers.emplace_back([&]() {
+            for (int j = 0; j < 1000; ++j) {
+                bus.publish(first, 1);
+            }
+        });
+    }
+
+    creator.join();
+    for (auto& th : publishers) {
+        th.join();
+    }
+
+    CHECK(sum == 4000);
+    CHECK(bus.size() == 2000);
+
+    bus.publish(bus.topic("topic-1999"), 1);
+    CHECK(sum == 4001);
+}
@@ -15,7 +15,9 @@
 */
 #include "fty/event.h"
 #include <catch2/catch.hpp>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <iostream>
 #include <thread>
 
@@ -133,3 +135,617 @@ TEST_CASE("Event thread")
 
     CHECK(42 == val);
 }
+
+TEST_CASE("Event reentrant")
+{
+    fty::Event<int> sig;
+    fty::Event<int> other;
+    int             calls      = 0;
+    int             otherCalls = 0;
+
+    fty::Slot<int> otherSlot([&](int) {
+        ++otherCalls;
+    });
+
+    fty::Slot<int> slot([&](int val) {
+        ++calls;
+        // Connect to the event which is emitting and emit other one from the slot
+        sig.connect(otherSlot);
+        other(std::move(val));
+    });
+    sig.connect(slot);
+    otherSlot.connect(other);
+
+    sig(1);
+    CHECK(calls == 1);
+    CHECK(otherCalls == 1);
+
+    sig(2);
+    CHECK(calls == 2);
+    CHECK(otherCalls == 3);
+}
+
+TEST_CASE("Event concurrent emit")
+{
+    fty::Event<int>  sig;
+    std::atomic<int> sum = 0;
+
+    fty::Slot<int> slot([&](int val) {
+        sum += val;
+    });
+    sig.connect(slot);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 1000; ++j) {
+                sig(1);
+            }
+        });
+    }
+
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    CHECK(sum == 4000);
+}
+
+TEST_CASE("Event emit scales with threads")
+{
+    // Emit takes no lock and writes no memory shared with other emitters, so they do not slow each other down
+    unsigned threadsCount = std::min(4u, std::thread::hardware_concurrency());
+    if (threadsCount < 2) {
+        return;
+    }
+
+    fty::Event<int>  sig;
+    std::atomic<int> sum = 0;
+    fty::Slot<int>   slot(
+        [&](int val) {
+            static thread_local int local = 0;
+            local += val;
+            if (local % 100000 == 0) {
+                sum += local;
+                local = 0;
+            }
+        },
+        fty::SlotPolicy::Concurrent);
+    sig.connect(slot);
+
+    constexpr int emits = 1000000;
+    auto          run   = [&](unsigned count) {
+        auto                     start = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (unsigned i = 0; i < count; ++i) {
+            threads.emplace_back([&]() {
+                for (int j = 0; j < emits; ++j) {
+                    sig(1);
+                }
+            });
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+        return std::chrono::steady_clock::now() - start;
+    };
+
+    auto single   = run(1);
+    auto parallel = run(threadsCount);
+
+    CHECK(sum == emits * int(threadsCount + 1));
+    // Every thread does the work of the single one: linear scaling keeps the wall time close to it
+    CHECK(parallel < single * 2);
+}
+
+TEST_CASE("Event slots destroyed while emitting")
+{
+    fty::Event<int>   sig;
+    std::atomic<bool> stop  = false;
+    std::atomic<int>  calls = 0;
+    std::atomic<int>  bad   = 0;
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]() {
+            while (!stop) {
+                sig(1);
+            }
+        });
+    }
+
+    auto payload = std::make_shared<int>(42);
+    for (int i = 0; i < 2000; ++i) {
+        // Callable captures the payload, it must stay valid while it is called
+        fty::Slot<int> slot(
+            [&calls, &bad, payload](int) {
+                bad += *payload != 42;
+                ++calls;
+            },
+            fty::SlotPolicy::Concurrent);
+        fty::ScopedConnection conn = sig.connect(slot);
+        std::this_thread::yield();
+    }
+
+    stop = true;
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    // Callables of destroyed slots are released once no emitter can call them, even if the event keeps their
+    // connections until the next connect
+    sig(1);
+    CHECK(payload.use_count() == 1);
+    CHECK(calls > 0);
+    CHECK(bad == 0);
+}
+
+TEST_CASE("Event queued slot")
+{
+    std::mutex                        mutex;
+    std::deque<std::function<void()>> queue;
+
+    fty::Executor executor = [&](std::function<void()> job) {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push_back(std::move(job));
+    };
+
+    auto runQueue = [&]() {
+        std::deque<std::function<void()>> jobs;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            std::swap(jobs, queue);
+        }
+        for (auto& job : jobs) {
+            job();
+        }
+    };
+
+    fty::Event<const std::string&> sig;
+    std::vector<std::string>       received;
+
+    fty::Slot<const std::string&> slot(
+        [&](const std::string& val) {
+            received.push_back(val);
+        },
+        executor);
+    sig.connect(slot);
+
+    {
+        std::string val = "hello";
+        sig(val);
+    }
+    CHECK(received.empty());
+    runQueue();
+    REQUIRE(received.size() == 1);
+    CHECK(received[0] == "hello");
+
+    {
+        fty::Slot<const std::string&> dropped(
+            [&](const std::string& val) {
+                received.push_back(val);
+            },
+            executor);
+        sig.connect(dropped);
+        std::string val = "world";
+        sig(val);
+    }
+    runQueue();
+    CHECK(received.size() == 2);
+}
+
+TEST_CASE("Event serialized slot")
+{
+    fty::Event<int> sig;
+    int             sum     = 0;
+    bool            overlap = false;
+    bool            inSlot  = false;
+
+    fty::Slot<int> slot(
+        [&](int val) {
+            overlap = overlap || inSlot;
+            inSlot  = true;
+            sum += val;
+            inSlot = false;
+        },
+        fty::SlotPolicy::Serialized);
+    sig.connect(slot);
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&]() {
+            for (int j = 0; j < 1000; ++j) {
+                sig(1);
+            }
+        });
+    }
+
+    for (auto& th : threads) {
+        th.join();
+    }
+
+    CHECK(sum == 4000);
+    CHECK(!overlap);
+}
+
+TEST_CASE("Event slot is serialized by default")
+{
+    // Emits from several threads never run the same default slot at the same time
+    fty::Event<int>         sig;
+    std::mutex              mutex;
+    std::condition_variable cv;
+    int                     inside    = 0;
+    int                     maxInside = 0;
+    int                     calls     = 0;
+    bool                    release   = false;
+
+    fty::Slot<int> slot([&](int) {
+        std::unique_lock<std::mutex> lock(mutex);
+        maxInside = std::max(maxInside, ++inside);
+        ++calls;
+        cv.notify_all();
+        cv.wait_for(lock, std::chrono::seconds(5), [&]() {
+            return release;
+        });
+        --inside;
+    });
+    sig.connect(slot);
+
+    std::thread first([&]() {
+        sig(1);
+    });
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait_for(lock, std::chrono::seconds(5), [&]() {
+            return calls == 1;
+        });
+    }
+
+    std::thread second([&]() {
+        sig(2);
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        CHECK(calls == 1);
+        release = true;
+        cv.notify_all();
+    }
+    first.join();
+    second.join();
+
+    CHECK(calls == 2);
+    CHECK(maxInside == 1);
+}
+
+TEST_CASE("Event concurrent slot")
+{
+    // SlotPolicy::Concurrent slot is called without the mutex: emits from several threads run it at the same time
+    fty::Event<int>         sig;
+    std::mutex              mutex;
+    std::condition_variable cv;
+    int                     inside    = 0;
+    int                     maxInside = 0;
+
+    fty::Slot<int> slot(
+        [&](int) {
+            std::unique_lock<std::mutex> lock(mutex);
+            maxInside = std::max(maxInside, ++inside);
+            cv.notify_all();
+            cv.wait_for(lock, std::chrono::seconds(5), [&]() {
+                return maxInside == 2;
+            });
+            --inside;
+        },
+        fty::SlotPolicy::Concurrent);
+    sig.connect(slot);
+
+    std::thread first([&]() {
+        sig(1);
+    });
+    std::thread second([&]() {
+        sig(2);
+    });
+    first.join();
+    second.join();
+
+    CHECK(maxInside == 2);
+}
+
+TEST_CASE("Event connect many slots")
+{
+    fty::Event<int> sig;
+    int             calls = 0;
+
+    fty::Slot<int> slot([&](int) {
+        ++calls;
+    });
+
+    for (int i = 0; i < 10; ++i) {
+        std::vector<fty::Slot<int>> temporary;
+        for (int j = 0; j < 100; ++j) {
+            temporary.emplace_back([&](int) {
+                ++calls;
+            });
+            sig.connect(temporary.back());
+        }
+    }
+    sig.connect(slot);
+
+    sig(1);
+    CHECK(calls == 1);
+}
+
+struct Payload
+{
+    Payload() = default;
+    Payload(const Payload& other)
+        : data(other.data)
+    {
+        ++copies;
+    }
+    Payload(Payload&&) = default;
+
+    std::vector<int> data = {1, 2, 3};
+    static int       copies;
+};
+int Payload::copies = 0;
+
+TEST_CASE("Event payload fan-out")
+{
+    fty::Event<Payload> sig;
+    std::vector<size_t> sizes;
+
+    fty::Slot<Payload> ref1([&](const Payload& val) {
+        sizes.push_back(val.data.size());
+    });
+    fty::Slot<Payload> ref2([&](const Payload& val) {
+        sizes.push_back(val.data.size());
+    });
+    fty::Slot<Payload> owner([&](Payload val) {
+        sizes.push_back(val.data.size());
+    });
+    sig.connect(ref1);
+    sig.connect(ref2);
+    sig.connect(owner);
+
+    SECTION("Rvalue: last slot takes ownership")
+    {
+        sig(Payload());
+        CHECK(std::vector<size_t>{3, 3, 3} == sizes);
+        CHECK(Payload::copies == 0);
+    }
+
+    SECTION("Lvalue: shared by all slots")
+    {
+        Payload payload;
+        sig.emit(payload);
+        CHECK(std::vector<size_t>{3, 3, 3} == sizes);
+        CHECK(Payload::copies == 1);
+        CHECK(payload.data.size() == 3);
+    }
+
+    Payload::copies = 0;
+}
+
+TEST_CASE("Event move only arguments")
+{
+    SECTION("Slot taking unique_ptr by value")
+    {
+        fty::Event<std::unique_ptr<int>> sig;
+        int                              received = 0;
+
+        fty::Slot<std::unique_ptr<int>> slot([&](std::unique_ptr<int> val) {
+            received = *val;
+        });
+        sig.connect(slot);
+
+        sig(std::make_unique<int>(42));
+        CHECK(received == 42);
+
+        // Value could not be shared with another slot
+        fty::Slot<std::unique_ptr<int>> other([&](const std::unique_ptr<int>&) {});
+        CHECK_THROWS_AS(sig.connect(other), std::logic_error);
+        CHECK_THROWS_AS(sig.emit(std::make_unique<int>(1)), std::logic_error);
+    }
+
+    SECTION("Slots taking unique_ptr by const reference")
+    {
+        fty::Event<std::unique_ptr<int>> sig;
+        int                              sum = 0;
+
+        fty::Slot<std::unique_ptr<int>> first([&](const std::unique_ptr<int>& val) {
+            sum += *val;
+        });
+        fty::Slot<std::unique_ptr<int>> second([&](const std::unique_ptr<int>& val) {
+            sum += *val;
+        });
+        sig.connect(first);
+        sig.connect(second);
+
+        sig(std::make_unique<int>(21));
+        CHECK(sum == 42);
+    }
+
+    SECTION("Slot taking rvalue reference")
+    {
+        fty::Event<std::string>  sig;
+        std::vector<std::string> received;
+
+        auto take = [&](std::string&& val) {
+            received.push_back(std::move(val));
+        };
+        fty::Slot<std::string> first(take);
+        fty::Slot<std::string> second(take);
+        sig.connect(first);
+        sig.connect(second);
+
+        // First slot gets a copy, the last one the emitted value
+        sig(std::string("ex-parrot"));
+        CHECK(received == std::vector<std::string>{"ex-parrot", "ex-parrot"});
+
+        std::string val = "Norwegian Blue";
+        sig.emit(val);
+        CHECK(val == "Norwegian Blue");
+        CHECK(received.size() == 4);
+        CHECK(received[3] == "Norwegian Blue");
+    }
+}
+
+TEST_CASE("Event connections")
+{
+    fty::Event<int> sig;
+    int             calls = 0;
+
+    fty::Slot<int> slot([&](int) {
+        ++calls;
+    });
+
+    SECTION("Disconnect")
+    {
+        fty::Connection conn = sig.connect(slot);
+        CHECK(conn.isConnected());
+        sig(1);
+        CHECK(calls == 1);
+
+        conn.disconnect();
+        CHECK(!conn.isConnected());
+        sig(1);
+        CHECK(calls == 1);
+    }
+
+    SECTION("Scoped connection")
+    {
+        {
+            fty::ScopedConnection conn = slot.connect(sig);
+            sig(1);
+            CHECK(calls == 1);
+        }
+        sig(1);
+        CHECK(calls == 1);
+
+        fty::Connection released;
+        {
+            fty::ScopedConnection conn = slot.connect(sig);
+            released                   = conn.release();
+        }
+        CHECK(released.isConnected());
+        sig(1);
+        CHECK(calls == 2);
+    }
+
+    SECTION("Expired slot")
+    {
+        fty::Connection conn;
+        {
+            fty::Slot<int> tmp([&](int) {
+                ++calls;
+            });
+            conn = sig.connect(tmp);
+            CHECK(conn.isConnected());
+        }
+        CHECK(!conn.isConnected());
+    }
+
+    SECTION("Rarely emitted event")
+    {
+        // Connections are compacted on connect, even if the event is never emitted
+        for (int i = 0; i < 10000; ++i) {
+            fty::ScopedConnection conn = sig.connect(slot);
+        }
+        auto conn = sig.connect(slot);
+        sig(1);
+        CHECK(calls == 1);
+    }
+}
+
+TEST_CASE("Event wait")
+{
+    using namespace std::chrono_literals;
+
+    fty::Event<> sig;
+
+    SECTION("Timeout")
+    {
+        auto ret = sig.wait(10ms);
+        CHECK(!ret);
+        CHECK("timeout" == ret.error());
+    }
+
+    SECTION("Emitted before wait")
+    {
+        sig();
+        CHECK(sig.wait(10ms));
+        CHECK(!sig.wait(10ms));
+    }
+
+    SECTION("Several waiters")
+    {
+        std::atomic<int>         woken = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 3; ++i) {
+            threads.emplace_back([&]() {
+                if (sig.wait(5s)) {
+                    ++woken;
+                }
+            });
+        }
+
+        std::this_thread::sleep_for(100ms);
+        sig();
+
+        for (auto& th : threads) {
+            th.join();
+        }
+        CHECK(woken == 3);
+    }
+}
+
+TEST_CASE("Event statistics")
+{
+    using namespace std::chrono_literals;
+
+    fty::Event<int> sig("timer-tick");
+
+    fty::Slot<int> fast([](int) {});
+    fty::Slot<int> slow([](int) {
+        std::this_thread::sleep_for(20ms);
+    });
+    fast.setName("fast");
+    slow.setName("slow");
+    sig.connect(fast);
+    sig.connect(slow);
+
+    // Calls made by other events are not counted in the statistics of this one
+    fty::Event<int> other("other");
+    other.connect(fast);
+    other(3);
+    other(4);
+    other(5);
+
+    sig(1);
+    sig(2);
+
+    auto stats = sig.statistics();
+#ifdef FTY_EVENT_PROFILING
+    CHECK(stats.name == "timer-tick");
+    CHECK(stats.fanOut.count == 2);
+    CHECK(stats.fanOut.total >= 40ms);
+    REQUIRE(stats.slots.size() == 2);
+    CHECK(stats.slots[0].name == "fast");
+    CHECK(stats.slots[0].calls.count == 2);
+    CHECK(stats.slots[1].name == "slow");
+    CHECK(stats.slots[1].calls.count == 2);
+    CHECK(stats.slots[1].calls.max >= 20ms);
+    CHECK(stats.slots[0].calls.max < stats.slots[1].calls.max);
+
+    auto otherStats = other.statistics();
+    REQUIRE(otherStats.slots.size() == 1);
+    CHECK(otherStats.slots[0].name == "fast");
+    CHECK(otherStats.slots[0].calls.count == 3);
+#else
+    CHECK(stats.name.empty());
+    CHECK(stats.fanOut.count == 0);
+    CHECK(stats.slots.empty());
+#endif
+}
@@ -0,0 +1,50 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#include "fty/histogram.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("Histogram")
+{
+    using namespace std::chrono_literals;
+
+    fty::Histogram hist;
+    CHECK(hist.snapshot().count == 0);
+    CHECK(hist.snapshot().average() == 0us);
+
+    hist.add(0us);
+    hist.add(3us);
+    hist.add(5ms);
+    hist.add(-10us);
+
+    auto snap = hist.snapshot();
+    CHECK(snap.count == 4);
+    CHECK(snap.max == 5000us);
+    CHECK(snap.total == 5003us);
+    CHECK(snap.buckets[0] == 2);
+    CHECK(snap.buckets[2] == 1);
+    CHECK(snap.buckets[13] == 1);
+    CHECK(snap.percentile(50) == 1us);
+    CHECK(snap.percentile(75) == 4us);
+    CHECK(snap.percentile(100) == 8192us);
+
+    CHECK(fty::Histogram::bucketLimit(0) == 1us);
+    CHECK(fty::Histogram::bucketLimit(2) == 4us);
+    CHECK(fty::Histogram::bucketLimit(13) == 8192us);
+
+    hist.reset();
+    CHECK(hist.snapshot().count == 0);
+    CHECK(hist.snapshot().max == 0us);
+}
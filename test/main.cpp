@@ -20,9 +20,15 @@
 //add all the include here, so that they appear in coverage report
 #include "fty/command-line.h"
 #include "fty/convert.h"
+#include "fty/event-bus.h"
 #include "fty/event.h"
 #include "fty/expected.h"
 #include "fty/flags.h"
+#include "fty/histogram.h"
+#include "fty/process-pipeline.h"
+#include "fty/process-pool.h"
+#include "fty/process-reactor.h"
+#include "fty/process-writer.h"
 #include "fty/process.h"
 #include "fty/string-utils.h"
 #include "fty/thread-pool.h"
@@ -0,0 +1,138 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#include "fty/process-pipeline.h"
+#include <catch2/catch.hpp>
+#include <chrono>
+#include <cstdio>
+
+TEST_CASE("ProcessPipeline")
+{
+    SECTION("Output and exit codes")
+    {
+        fty::ProcessPipeline pipeline;
+        pipeline.add("printf", {"c\\nb\\na\\n"}).add("sort").add("sh", {"-c", "cat; exit 3"});
+        REQUIRE(pipeline.run());
+
+        CHECK(pipeline.readAllStandardOutput() == "a\nb\nc\n");
+        auto codes = pipeline.wait();
+        REQUIRE(codes);
+        CHECK(*codes == std::vector<int>{0, 0, 3});
+    }
+
+    SECTION("Input and stderr")
+    {
+        fty::ProcessPipeline pipeline;
+        pipeline.add("sh", {"-c", "cat; echo first >&2"}).add("sh", {"-c", "tr a-z A-Z; echo second >&2"});
+        REQUIRE(pipeline.run(fty::Capture::In | fty::Capture::Out | fty::Capture::Err));
+
+        std::string input(1024 * 1024, 'x');
+        std::thread writer([&]() {
+            CHECK(pipeline.write(input));
+            pipeline.closeWriteChannel();
+        });
+
+        std::string out;
+        std::string err;
+        CHECK(pipeline.readAll(out, err, 10000));
+        writer.join();
+
+        CHECK(out == std::string(input.size(), 'X'));
+        CHECK(err.find("first") != std::string::npos);
+        CHECK(err.find("second") != std::string::npos);
+        CHECK(pipeline.wait(5000));
+    }
+
+    SECTION("Tap")
+    {
+        FILE* file = tmpfile();
+        REQUIRE(file);
+
+        std::string data(512 * 1024, 'y');
+        fty::ProcessPipeline pipeline;
+        pipeline.add("head", {"-c", std::to_string(data.size()), "/dev/zero"}).add("tr", {"\\0", "y"}).add("wc", {"-c"});
+        pipeline.tap(1, fileno(file));
+        REQUIRE(pipeline.run());
+
+        CHECK(pipeline.readAllStandardOutput() == std::to_string(data.size()) + "\n");
+        REQUIRE(pipeline.wait());
+
+        std::string tapped(data.size() + 1, '\0');
+        rewind(file);
+        tapped.resize(fread(&tapped[0], 1, tapped.size(), file));
+        CHECK(tapped == data);
+        fclose(file);
+    }
+
+    SECTION("Tap of the last stage")
+    {
+        int tapPipe[2];
+        REQUIRE(pipe(tapPipe) == 0);
+
+        fty::ProcessPipeline pipeline;
+        pipeline.add("echo", {"hello"});
+        pipeline.tap(0, tapPipe[1]);
+        CHECK(!pipeline.run(fty::Capture::None));
+        REQUIRE(pipeline.run());
+
+        CHECK(pipeline.readAllStandardOutput() == "hello\n");
+        REQUIRE(pipeline.wait());
+        close(tapPipe[1]);
+        CHECK(fty::readFromFd(tapPipe[0], 1000) == "hello\n");
+        close(tapPipe[0]);
+    }
+
+    SECTION("Next stage exits early")
+    {
+        fty::ProcessPipeline pipeline;
+        pipeline.add("yes").add("head", {"-n", "2"});
+        REQUIRE(pipeline.run());
+        CHECK(pipeline.readAllStandardOutput() == "y\ny\n");
+        auto codes = pipeline.wait(5000);
+        REQUIRE(codes);
+        CHECK((*codes)[0] == SIGPIPE);
+        CHECK((*codes)[1] == 0);
+    }
+
+    SECTION("Wait")
+    {
+        auto before = fty::Process::statistics()["sleep"].runs;
+
+        fty::ProcessPipeline pipeline;
+        pipeline.add("sleep", {"0.2"}).add("cat");
+        REQUIRE(pipeline.run());
+
+        auto timeout = pipeline.wait(50);
+        REQUIRE(!timeout);
+        CHECK(timeout.error() == "timeout");
+
+        auto start = std::chrono::steady_clock::now();
+        auto codes = pipeline.wait(5000);
+        REQUIRE(codes);
+        CHECK(*codes == std::vector<int>{0, 0});
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+
+        // Stages are accounted as any other process
+        CHECK(fty::Process::statistics()["sleep"].runs == before + 1);
+    }
+
+    SECTION("Unknown command")
+    {
+        fty::ProcessPipeline pipeline;
+        pipeline.add("echo", {"hello"}).add("/unknown/command");
+        CHECK(!pipeline.run());
+        CHECK(!fty::ProcessPipeline().run());
+    }
+}
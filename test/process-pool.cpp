@@ -0,0 +1,97 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#include "fty/process-pool.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("ProcessPool")
+{
+    using namespace std::chrono_literals;
+
+    SECTION("Line framing")
+    {
+        fty::ProcessPool pool("cat");
+        for (int i = 0; i < 10; ++i) {
+            auto ret = pool.request("hello " + std::to_string(i));
+            REQUIRE(ret);
+            CHECK(*ret == "hello " + std::to_string(i));
+        }
+        CHECK(pool.restarts() == 0);
+        CHECK(!pool.request("two\nlines"));
+    }
+
+    SECTION("Length prefixed framing")
+    {
+        fty::ProcessPool pool("cat", {}, 1, fty::ProcessPool::Framing::LengthPrefixed);
+
+        std::string binary("a\nb\0c", 5);
+        auto        ret = pool.request(binary);
+        REQUIRE(ret);
+        CHECK(*ret == binary);
+
+        std::string big(256 * 1024, 'x');
+        auto bigRet = pool.request(big);
+        REQUIRE(bigRet);
+        CHECK(*bigRet == big);
+    }
+
+    SECTION("Concurrent requests")
+    {
+        fty::ProcessPool         pool("cat", {}, 2);
+        std::atomic<int>         ok = 0;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < 4; ++i) {
+            threads.emplace_back([&, i]() {
+                for (int j = 0; j < 50; ++j) {
+                    std::string msg = std::to_string(i) + ":" + std::to_string(j);
+                    if (auto ret = pool.request(msg); ret && *ret == msg) {
+                        ++ok;
+                    }
+                }
+            });
+        }
+        for (auto& th : threads) {
+            th.join();
+        }
+        CHECK(ok == 200);
+    }
+
+    SECTION("Timeout")
+    {
+        fty::ProcessPool pool("sh", {"-c", "while read l; do sleep 1; echo \"$l\"; done"});
+
+        auto ret = pool.request("slow", 100);
+        REQUIRE(!ret);
+        CHECK(ret.error() == "timeout");
+
+        // Late response of the killed worker is not mixed with the next one
+        auto next = pool.request("next", 3000);
+        REQUIRE(next);
+        CHECK(*next == "next");
+        CHECK(pool.restarts() == 1);
+    }
+
+    SECTION("Crashed worker")
+    {
+        fty::ProcessPool pool("sh", {"-c", "read line; echo \"$line\""});
+        for (int i = 0; i < 3; ++i) {
+            auto ret = pool.request("once");
+            REQUIRE(ret);
+            CHECK(*ret == "once");
+            std::this_thread::sleep_for(100ms);
+        }
+        CHECK(pool.restarts() == 2);
+    }
+}
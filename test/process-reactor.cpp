@@ -0,0 +1,80 @@
+/*  ========================================================================
+    Copyright (C) 2021 Eaton
+    This program is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License along
+    with this program; if not, write to the Free Software Foundation, Inc.,
+    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+    ========================================================================
+*/
+#include "fty/process-reactor.h"
+#include <catch2/catch.hpp>
+
+TEST_CASE("ProcessReactor")
+{
+    fty::ProcessReactor reactor;
+
+    SECTION("Output and exit code")
+    {
+        auto future = reactor.run("sh", {"-c", "echo -n hello; 1>&2 echo -n world; exit 3"});
+        auto result = future.get();
+        REQUIRE(result);
+        CHECK(result->exitCode == 3);
+        CHECK(result->out == "hello");
+        CHECK(result->err == "world");
+    }
+
+    SECTION("Input")
+    {
+        std::string input(1024 * 1024, 'x');
+        auto        result = reactor.run("cat", {}, input).get();
+        REQUIRE(result);
+        CHECK(result->exitCode == 0);
+        CHECK(result->out == input);
+    }
+
+    SECTION("Huge output on both channels")
+    {
+        auto result = reactor.run("sh", {"-c", "head -c 1000000 /dev/zero; head -c 1000000 /dev/zero 1>&2"}).get();
+        REQUIRE(result);
+        CHECK(result->out.size() == 1000000);
+        CHECK(result->err.size() == 1000000);
+    }
+
+    SECTION("Invalid command")
+    {
+        auto result = reactor.run("/usr/bin/bad").get();
+        CHECK(!result);
+    }
+
+    SECTION("Many children")
+    {
+        std::vector<std::future<fty::Expected<fty::ProcessReactor::Result>>> futures;
+        for (int i = 0; i < 50; ++i) {
+            futures.push_back(reactor.run("sh", {"-c", "sleep 0.1; echo -n " + std::to_string(i)}));
+        }
+
+        for (int i = 0; i < 50; ++i) {
+            auto result = futures[size_t(i)].get();
+            REQUIRE(result);
+            CHECK(result->out == std::to_string(i));
+        }
+        CHECK(reactor.running() == 0);
+    }
+
+    SECTION("Callback")
+    {
+        std::promise<int> codePromise;
+        auto              ret = reactor.run("sh", {"-c", "exit 7"}, [&](fty::Expected<fty::ProcessReactor::Result>&& result) {
+            codePromise.set_value(result ? result->exitCode : -1);
+        });
+        REQUIRE(ret);
+        CHECK(codePromise.get_future().get() == 7);
+    }
+}
@@ -13,6 +13,7 @@
     51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
     ========================================================================
 */
+#include "fty/process-writer.h"
 #include "fty/process.h"
 #include "fty/string-utils.h"
 #include <catch2/catch.hpp>
@@ -160,6 +161,27 @@ TEST_CASE("Process basic tests")
     }
 }
 
+TEST_CASE("Process wait latency")
+{
+    auto process = fty::Process("sh", {"-c", "sleep 0.2"}, fty::Capture::None);
+    REQUIRE(process.run());
+
+    auto start  = std::chrono::steady_clock::now();
+    auto status = process.wait(5000);
+    auto end    = std::chrono::steady_clock::now();
+
+    REQUIRE(status);
+    CHECK(*status == 0);
+    // Process ends after 200ms, wait should notice it without sleeping for the whole wait cycle
+    CHECK(end - start < std::chrono::milliseconds(280));
+
+    auto exitCode = fty::Process("sh", {"-c", "exit 3"}, fty::Capture::None);
+    REQUIRE(exitCode.run());
+    auto code = exitCode.wait(5000);
+    REQUIRE(code);
+    CHECK(*code == 3);
+}
+
 TEST_CASE("Write in process 2 time")
 {
     auto process = fty::Process("/bin/cat");
@@ -213,6 +235,27 @@ TEST_CASE("Launch 2 process at the time")
     }
 }
 
+TEST_CASE("Launch 2 overlapping processes")
+{
+    // Second child must not inherit the stdin of the first one, or the first one never sees the end of file
+    auto start   = std::chrono::steady_clock::now();
+    auto counter = fty::Process("sh", {"-c", "sleep 0.2; wc -c"});
+    REQUIRE(counter.run());
+    auto sleeper = fty::Process("sleep", {"3"});
+    REQUIRE(sleeper.run());
+
+    CHECK(counter.write(std::string(1024 * 1024, 'x')));
+    counter.closeWriteChannel();
+    auto status  = counter.wait(10000);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    REQUIRE(status);
+    CHECK(*status == 0);
+    CHECK(fty::trimmed(counter.readAllStandardOutput()) == "1048576");
+    CHECK(elapsed < std::chrono::milliseconds(2000));
+    sleeper.kill();
+}
+
 TEST_CASE("Launch 2 process at the time with launcher in separeted thread")
 {
     using namespace std::chrono_literals;
@@ -252,3 +295,401 @@ TEST_CASE("Process with Huge data")
     CHECK(pid);
     CHECK(process.readAllStandardOutput().size());
 }
+
+TEST_CASE("Process streaming output")
+{
+    SECTION("Lines")
+    {
+        auto process = fty::Process("sh", {"-c", "for i in 1 2 3; do echo line$i; sleep 0.05; done; echo -n last"});
+        REQUIRE(process.run());
+
+        std::vector<std::string> lines;
+        auto                     ret = process.readLines(fty::Capture::Out, [&](std::string_view line) {
+            lines.emplace_back(line);
+        });
+        CHECK(ret);
+        CHECK(std::vector<std::string>{"line1", "line2", "line3", "last"} == lines);
+        CHECK(process.wait());
+    }
+
+    SECTION("Chunks")
+    {
+        auto process = fty::Process("head", {"-c", "1000000", "/dev/zero"});
+        REQUIRE(process.run());
+
+        size_t total    = 0;
+        size_t maxChunk = 0;
+        auto   ret      = process.readOutput(fty::Capture::Out, [&](std::string_view chunk) {
+            total += chunk.size();
+            maxChunk = std::max(maxChunk, chunk.size());
+        });
+        CHECK(ret);
+        CHECK(total == 1000000);
+        CHECK(maxChunk > 1024);
+        CHECK(process.wait());
+    }
+
+    SECTION("Timeout")
+    {
+        auto process = fty::Process("sh", {"-c", "echo -n begin 1>&2; sleep 2"});
+        REQUIRE(process.run());
+
+        std::string err;
+        auto        ret = process.readOutput(
+            fty::Capture::Err,
+            [&](std::string_view chunk) {
+                err.append(chunk);
+            },
+            100);
+        CHECK(!ret);
+        CHECK("timeout" == ret.error());
+        CHECK("begin" == err);
+        process.kill();
+    }
+
+    SECTION("Timeout with partial line")
+    {
+        auto process = fty::Process("sh", {"-c", "echo first; echo -n cut; sleep 2"});
+        REQUIRE(process.run());
+
+        std::vector<std::string> lines;
+        auto                     ret = process.readLines(
+            fty::Capture::Out,
+            [&](std::string_view line) {
+                lines.emplace_back(line);
+            },
+            300);
+        CHECK(!ret);
+        CHECK("timeout" == ret.error());
+        CHECK(std::vector<std::string>{"first"} == lines);
+        process.kill();
+    }
+}
+
+TEST_CASE("Process read both channels")
+{
+    SECTION("Full stderr pipe")
+    {
+        // Child fills stderr pipe before writing to stdout, sequential reading would block it
+        auto process = fty::Process("sh", {"-c", "head -c 300000 /dev/zero 1>&2; head -c 300000 /dev/zero"});
+        REQUIRE(process.run());
+
+        std::string out, err;
+        process.readAll(out, err, 10000);
+        CHECK(out.size() == 300000);
+        CHECK(err.size() == 300000);
+        CHECK(process.wait());
+    }
+
+    SECTION("Static run")
+    {
+        std::string out, err;
+        auto        ret = fty::Process::run("sh", {"-c", "head -c 300000 /dev/zero 1>&2; head -c 300000 /dev/zero; exit 2"}, out, err);
+        REQUIRE(ret);
+        CHECK(*ret == 2);
+        CHECK(out.size() == 300000);
+        CHECK(err.size() == 300000);
+
+        // Quiet child, output comes after the quiet period of the reader
+        auto late = fty::Process::run("sh", {"-c", "sleep 0.5; echo -n late"}, out, 1024 * 1024);
+        REQUIRE(late);
+        CHECK(out == "late");
+    }
+
+    SECTION("Descriptor above FD_SETSIZE")
+    {
+        int fds[2];
+        REQUIRE(pipe(fds) == 0);
+        int high = fcntl(fds[0], F_DUPFD, 2000);
+        close(fds[0]);
+        if (high < 0) {
+            close(fds[1]);
+            WARN("Cannot open descriptor above 2000, skipped");
+            return;
+        }
+
+        CHECK(::write(fds[1], "hello", 5) == 5);
+        close(fds[1]);
+        CHECK("hello" == fty::readFromFd(high, 1000));
+        close(high);
+    }
+
+    SECTION("Deadline")
+    {
+        auto process = fty::Process("sh", {"-c", "echo -n begin; sleep 2"});
+        REQUIRE(process.run());
+
+        auto start = std::chrono::steady_clock::now();
+        CHECK("begin" == process.readAllStandardOutput(200));
+        CHECK(std::chrono::steady_clock::now() - start < std::chrono::milliseconds(1000));
+        process.kill();
+    }
+}
+
+TEST_CASE("Process environment")
+{
+    setenv("FTY_PROCESS_TEST", "inherited", 1);
+
+    SECTION("Inherited")
+    {
+        std::string out;
+        auto        ret = fty::Process::run("sh", {"-c", "echo -n $FTY_PROCESS_TEST"}, out);
+        REQUIRE(ret);
+        CHECK(out == "inherited");
+    }
+
+    SECTION("Overridden")
+    {
+        auto process = fty::Process("sh", {"-c", "env | grep FTY_PROCESS_TEST"});
+        process.setEnvVar("FTY_PROCESS_TEST", "overridden");
+        REQUIRE(process.run());
+        CHECK(process.readAllStandardOutput() == "FTY_PROCESS_TEST=overridden\n");
+        CHECK(process.wait());
+    }
+
+    unsetenv("FTY_PROCESS_TEST");
+}
+
+TEST_CASE("Process async writer")
+{
+    SECTION("Large input overlaps with output")
+    {
+        fty::Process process("cat", {}, fty::Capture::In | fty::Capture::Out);
+        REQUIRE(process.run());
+
+        std::vector<bool>  pressure;
+        fty::ProcessWriter writer(process, 256 * 1024, [&](bool full) {
+            pressure.push_back(full);
+        });
+
+        // Much more than the pipes could hold, cat blocks until the output is read
+        std::string chunk(4096, 'x');
+        bool        queued = true;
+        for (int i = 0; i < 2048; ++i) {
+            queued = writer.write(chunk) && queued;
+        }
+        CHECK(queued);
+        auto done = writer.close();
+        CHECK(!writer.write(chunk));
+
+        size_t read = 0;
+        CHECK(process.readOutput(
+            fty::Capture::Out,
+            [&](std::string_view data) {
+                read += data.size();
+            },
+            10000));
+        CHECK(read == chunk.size() * 2048);
+
+        REQUIRE(done.wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+        CHECK(done.get());
+        CHECK(writer.pending() == 0);
+        CHECK(std::vector<bool>{true, false} == pressure);
+        CHECK(*process.wait() == 0);
+    }
+
+    SECTION("Producer paused by backpressure")
+    {
+        fty::Process process("cat", {}, fty::Capture::In | fty::Capture::Out);
+        REQUIRE(process.run());
+
+        std::mutex              mutex;
+        std::condition_variable cv;
+        bool                    paused = false;
+        std::vector<bool>       pressure;
+
+        fty::ProcessWriter writer(process, 64 * 1024, [&](bool full) {
+            std::lock_guard<std::mutex> lock(mutex);
+            pressure.push_back(full);
+            paused = full;
+            cv.notify_all();
+        });
+
+        size_t      read = 0;
+        std::thread reader([&]() {
+            process.readOutput(
+                fty::Capture::Out,
+                [&](std::string_view data) {
+                    read += data.size();
+                },
+                20000);
+        });
+
+        // Producer waits for the release every time it is told to pause, it must never wait forever
+        std::string chunk(1024, 'x');
+        bool        released = true;
+        for (int i = 0; i < 4096 && released; ++i) {
+            writer.write(chunk);
+            std::unique_lock<std::mutex> lock(mutex);
+            released = cv.wait_for(lock, std::chrono::seconds(5), [&]() {
+                return !paused;
+            });
+        }
+        CHECK(released);
+        REQUIRE(writer.close().get());
+        reader.join();
+        CHECK(read == chunk.size() * 4096);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        REQUIRE(!pressure.empty());
+        for (size_t i = 0; i < pressure.size(); ++i) {
+            CHECK(pressure[i] == (i % 2 == 0));
+        }
+        CHECK(!pressure.back());
+        CHECK(*process.wait() == 0);
+    }
+
+    SECTION("Process does not read")
+    {
+        fty::Process process("true", {}, fty::Capture::In);
+        REQUIRE(process.run());
+        fty::ProcessWriter writer(process);
+
+        CHECK(writer.write(std::string(1024 * 1024, 'x')));
+        auto ret = writer.close().get();
+        REQUIRE(!ret);
+        CHECK(ret.error() == "Process closed its input");
+        CHECK(process.wait());
+    }
+
+    SECTION("Stdin not captured")
+    {
+        fty::Process process("true", {}, fty::Capture::Out);
+        REQUIRE(process.run());
+        fty::ProcessWriter writer(process);
+        CHECK(!writer.write("data"));
+        CHECK(!writer.close().get());
+    }
+}
+
+TEST_CASE("Process resources")
+{
+    using namespace std::chrono_literals;
+
+    SECTION("Usage")
+    {
+        fty::Process process("sh", {"-c", "i=0; while [ $i -lt 20000 ]; do i=$((i+1)); done"});
+        REQUIRE(process.run());
+        auto status = process.waitStatus();
+        REQUIRE(status);
+        CHECK(status->exitCode == 0);
+        CHECK(status->usage.userTime + status->usage.systemTime > 0us);
+        CHECK(status->usage.maxRss > 0);
+        CHECK(process.usage().maxRss == status->usage.maxRss);
+    }
+
+    SECTION("Limit")
+    {
+        fty::Process process("sh", {"-c", "while :; do :; done"});
+        process.setLimit(RLIMIT_CPU, 1);
+        REQUIRE(process.run());
+        auto status = process.waitStatus(10000);
+        REQUIRE(status);
+        CHECK((status->exitCode == SIGXCPU || status->exitCode == SIGKILL));
+        CHECK(status->usage.userTime + status->usage.systemTime >= 900ms);
+    }
+
+    SECTION("Limit applies before exec")
+    {
+        fty::Process process("sh", {"-c", "ulimit -n"}, fty::Capture::Out);
+        process.setLimit(RLIMIT_NOFILE, 64);
+        REQUIRE(process.run());
+        CHECK(process.readAllStandardOutput(5000) == "64\n");
+        CHECK(*process.wait() == 0);
+    }
+
+    SECTION("Restricted unknown command")
+    {
+        fty::Process process("/unknown/command");
+        process.setLimit(RLIMIT_NOFILE, 64);
+        REQUIRE(process.run());
+        CHECK(*process.wait() == 127);
+    }
+
+    SECTION("Invalid limit")
+    {
+        fty::Process process("sleep", {"10"});
+        process.setLimit(RLIMIT_NOFILE, 10, 5);
+        auto ret = process.run();
+        REQUIRE(!ret);
+        CHECK(!process.exists());
+    }
+
+    SECTION("Invalid cgroup")
+    {
+        fty::Process process("sleep", {"10"});
+        process.setCgroup("/unknown/cgroup");
+        auto ret = process.run();
+        REQUIRE(!ret);
+        CHECK(ret.error().find("/unknown/cgroup") != std::string::npos);
+        CHECK(!process.exists());
+    }
+
+    SECTION("Statistics")
+    {
+        auto before = fty::Process::statistics()["true"];
+        for (int i = 0; i < 3; ++i) {
+            CHECK(fty::Process::run("true", {}));
+        }
+        auto after = fty::Process::statistics()["true"];
+        CHECK(after.runs == before.runs + 3);
+        CHECK(after.usage.maxRss > 0);
+    }
+}
+
+TEST_CASE("Process output to file")
+{
+    SECTION("Mapped output")
+    {
+        fty::Process process("seq", {"1", "200000"}, fty::Capture::OutFile);
+        REQUIRE(process.run());
+        CHECK(!process.mappedOutput());
+        REQUIRE(process.wait());
+
+        auto output = process.mappedOutput();
+        REQUIRE(output);
+        std::string expected;
+        for (int i = 1; i <= 200000; ++i) {
+            expected += std::to_string(i) + "\n";
+        }
+        CHECK(output->size() == expected.size());
+        CHECK(output->view() == expected);
+
+        // View outlives the process and survives moves
+        fty::MappedOutput moved = std::move(*output);
+        CHECK(moved.view().substr(0, 4) == "1\n2\n");
+    }
+
+    SECTION("Long command path")
+    {
+        std::string cmd = "/bin/";
+        for (int i = 0; i < 200; ++i) {
+            cmd += "./";
+        }
+        cmd += "echo";
+
+        fty::Process process(cmd, {"hello"}, fty::Capture::OutFile);
+        REQUIRE(process.run());
+        REQUIRE(process.wait());
+        auto output = process.mappedOutput();
+        REQUIRE(output);
+        CHECK(output->view() == "hello\n");
+    }
+
+    SECTION("Empty output")
+    {
+        fty::Process process("true", {}, fty::Capture::OutFile | fty::Capture::Err);
+        REQUIRE(process.run());
+        REQUIRE(process.wait());
+        auto output = process.mappedOutput();
+        REQUIRE(output);
+        CHECK(output->view().empty());
+    }
+
+    SECTION("Exclusive with pipe")
+    {
+        fty::Process process("true", {}, fty::Capture::OutFile | fty::Capture::Out);
+        CHECK(!process.run());
+        CHECK(!fty::Process("true").mappedOutput());
+    }
+}
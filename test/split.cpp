@@ -15,6 +15,8 @@
 */
 #include "fty/string-utils.h"
 #include <catch2/catch.hpp>
+#include <chrono>
+#include <iostream>
 
 
 TEST_CASE("Split utils")
@@ -48,6 +50,12 @@ TEST_CASE("Split utils")
         CHECK(std::vector<std::string>{"Norwegian    ", "    Blue"} == vec2);
     }
 
+    SECTION("Vector, multi-char delimiter")
+    {
+        auto vec = fty::split("this::is:an::ex-parrot::", "::");
+        CHECK(std::vector<std::string>{"this", "is:an", "ex-parrot"} == vec);
+    }
+
     SECTION("Vector, split regex")
     {
         try {
@@ -113,3 +121,351 @@ TEST_CASE("Strange split")
         FAIL(e.what());
     }
 }
+
+TEST_CASE("Split pattern")
+{
+    SECTION("Same as regex")
+    {
+        std::vector<std::string> patterns = {",", ",+", "[,;]+", "\\s+", "\\|", "[^a-z]", "=+", "[ \\t]+", "[0-9]", "\\d+",
+            "[a-c-]+", "(,)", ", *", "[[:space:]]+"};
+        std::vector<std::string> inputs   = {"", ",", ",,", "a", " a , b ", "a,b;;c", ",a,,b,", "a|b||c", "key = 42 ==  x",
+            "  this\t is\n an\r\n ex-parrot ", "x1y22z333", "a-b--c", ";;;", "a=\xff=b"};
+
+        for (const auto& pattern : patterns) {
+            fty::SplitPattern compiled(pattern);
+            std::regex        re(pattern);
+            for (const auto& input : inputs) {
+                for (auto opt : {fty::SplitOption::SkipEmpty | fty::SplitOption::Trim, fty::SplitOption::KeepEmpty | fty::SplitOption::Trim,
+                         fty::SplitOption::SkipEmpty | fty::SplitOption::NoTrim, fty::SplitOption::KeepEmpty | fty::SplitOption::NoTrim}) {
+                    INFO(pattern << " on '" << input << "'");
+                    CHECK(fty::split(input, compiled, opt) == fty::split(input, re, opt));
+                }
+            }
+        }
+    }
+
+    SECTION("Simple patterns")
+    {
+        CHECK(fty::SplitPattern(",").isSimple());
+        CHECK(fty::SplitPattern("\\s+").isSimple());
+        CHECK(fty::SplitPattern("[^a-z0-9]+").isSimple());
+        CHECK(fty::SplitPattern("\\.").isSimple());
+        CHECK_FALSE(fty::SplitPattern(", *").isSimple());
+        CHECK_FALSE(fty::SplitPattern("(,)").isSimple());
+        CHECK_FALSE(fty::SplitPattern("[[:space:]]").isSimple());
+        CHECK_FALSE(fty::SplitPattern(".").isSimple());
+        CHECK_THROWS_AS(fty::SplitPattern("(,"), std::regex_error);
+    }
+
+    SECTION("Cache")
+    {
+        auto first = fty::SplitPattern::cached("=+");
+        CHECK(first == fty::SplitPattern::cached("=+"));
+        CHECK(first != fty::SplitPattern::cached(";"));
+        CHECK(first->pattern() == "=+");
+
+        auto [name, val] = fty::split<std::string, int>("sense of life === 42", *first);
+        CHECK(name == "sense of life");
+        CHECK(val == 42);
+    }
+
+    SECTION("Groups")
+    {
+        auto [key, value] = fty::split<std::string, std::string>("key = \"value\"", fty::SplitPattern("([a-zA-Z0-9]+)\\s*=\\s*\"([^\"]+)\""));
+        CHECK(key == "key");
+        CHECK(value == "value");
+    }
+}
+
+TEST_CASE("Typed split")
+{
+    SECTION("Same as split")
+    {
+        for (const char* str : {"sense of life = 42", "sense of life", "sense of life = 42 = 66", "", " = 7", "x =  -3  "}) {
+            auto tuple = fty::trySplit<std::string, int>(str, "=");
+            REQUIRE(tuple);
+            CHECK(*tuple == fty::split<std::string, int>(str, "="));
+        }
+
+        auto tuple = fty::trySplit<std::string_view, double, bool, uint16_t>("temp;-12.5;true;+8080", ";");
+        REQUIRE(tuple);
+        CHECK(*tuple == std::make_tuple("temp", -12.5, true, uint16_t(8080)));
+
+        auto empty = fty::trySplit<int, std::string, int>("1,,3", ",");
+        REQUIRE(empty);
+        CHECK(*empty == std::make_tuple(1, "", 3));
+    }
+
+    SECTION("Errors")
+    {
+        auto garbage = fty::trySplit<std::string, int>("answer = 42 abc", "=");
+        REQUIRE_FALSE(garbage);
+        CHECK(garbage.error() == "Field 1 '42 abc': not a number");
+
+        auto range = fty::trySplit<int8_t, uint8_t>("127,256", ",");
+        REQUIRE_FALSE(range);
+        CHECK(range.error() == "Field 1 '256': out of range");
+
+        CHECK_FALSE(fty::trySplit<uint32_t>("-1", ","));
+        CHECK_FALSE(fty::trySplit<int>("+-1", ","));
+        CHECK_FALSE(fty::trySplit<bool>("yes", ","));
+        CHECK_FALSE(fty::trySplit<double>("1.5.6", ","));
+        CHECK(fty::trySplit<int8_t>("-128", ","));
+    }
+
+    SECTION("Views point to the input")
+    {
+        std::string str   = "key = value";
+        auto        tuple = fty::trySplit<std::string_view, std::string_view>(str, "=");
+        REQUIRE(tuple);
+        CHECK(std::get<0>(*tuple).data() == str.data());
+        CHECK(std::get<1>(*tuple) == "value");
+    }
+}
+
+TEST_CASE("Split view")
+{
+    using Views = std::vector<std::string_view>;
+
+    SECTION("Trimmed view")
+    {
+        CHECK(fty::trimmedView("  Norwegian Blue \t\r\n") == "Norwegian Blue");
+        CHECK(fty::trimmedView("ex-parrot") == "ex-parrot");
+        CHECK(fty::trimmedView(" \t ").empty());
+        CHECK(fty::trimmedView("").empty());
+
+        std::string str = " it's dead ";
+        auto        view = fty::trimmedView(str);
+        CHECK(view.data() == str.data() + 1);
+    }
+
+    SECTION("Split rules")
+    {
+        auto split = [](std::string_view str, fty::SplitOption opt) {
+            auto range = fty::splitView(str, "|", opt);
+            return Views(range.begin(), range.end());
+        };
+
+        CHECK(split("this||is|an|ex-parrot|", fty::SplitOption::SkipEmpty | fty::SplitOption::Trim) ==
+              Views{"this", "is", "an", "ex-parrot"});
+        // Nothing after the last delimiter is not a field
+        CHECK(split("||a||", fty::SplitOption::KeepEmpty | fty::SplitOption::NoTrim) == Views{"", "", "a", ""});
+        // Emptiness is checked before trimming
+        CHECK(split("  |x", fty::SplitOption::SkipEmpty | fty::SplitOption::Trim) == Views{"", "x"});
+        CHECK(split("  Norwegian | Blue  ", fty::SplitOption::SkipEmpty | fty::SplitOption::NoTrim) == Views{"  Norwegian ", " Blue  "});
+        CHECK(split("", fty::SplitOption::KeepEmpty).empty());
+        CHECK(split("|", fty::SplitOption::KeepEmpty) == Views{""});
+    }
+
+    SECTION("Views point to the input")
+    {
+        std::string str   = "key = value ; other=1;";
+        auto        range = fty::splitView(str, ";");
+        Views       parts(range.begin(), range.end());
+        REQUIRE(parts.size() == 2);
+        CHECK(parts[0] == "key = value");
+        CHECK(parts[1] == "other=1");
+        CHECK(parts[0].data() == str.data());
+
+        size_t count = 0;
+        for (std::string_view part : fty::splitView(str, ";", fty::SplitOption::KeepEmpty)) {
+            CHECK(part.data() >= str.data());
+            CHECK(part.data() + part.size() <= str.data() + str.size());
+            ++count;
+        }
+        CHECK(count == 2);
+    }
+
+    SECTION("Empty delimiter")
+    {
+        auto range = fty::splitView("ex-parrot", "");
+        CHECK(Views(range.begin(), range.end()) == Views{"ex-parrot"});
+    }
+}
+
+TEST_CASE("Split vectorized scan")
+{
+    namespace scan = fty::detail::scan;
+
+    std::string data;
+    for (size_t i = 0; i < 4096; ++i) {
+        data.push_back(" \t\n\r,;ab"[(i * 7919 + i / 13) % 8]);
+    }
+
+    SECTION("Masks")
+    {
+        for (size_t off = 0; off + scan::BlockSize <= data.size(); off += 37) {
+            const char* block = data.data() + off;
+            for (char ch : {',', ';', 'a', 'x'}) {
+                uint64_t expected = scan::byteMaskScalar(block, scan::BlockSize, ch);
+                CHECK(scan::byteMask()(block, scan::BlockSize, ch) == expected);
+#ifdef FTY_SCAN_X86
+                CHECK(scan::byteMaskSse2(block, scan::BlockSize, ch) == expected);
+                if (scan::hasAvx2()) {
+                    CHECK(scan::byteMaskAvx2(block, scan::BlockSize, ch) == expected);
+                }
+#endif
+            }
+
+            uint64_t expected = scan::spaceMaskScalar(block, scan::BlockSize);
+            CHECK(scan::spaceMask()(block, scan::BlockSize) == expected);
+#ifdef FTY_SCAN_X86
+            CHECK(scan::spaceMaskSse2(block, scan::BlockSize) == expected);
+            if (scan::hasAvx2()) {
+                CHECK(scan::spaceMaskAvx2(block, scan::BlockSize) == expected);
+            }
+#endif
+        }
+    }
+
+    SECTION("Long line")
+    {
+        for (size_t len : {0, 1, 63, 64, 65, 127, 128, 1000, 4096}) {
+            std::string_view line(data.data(), len);
+
+            std::vector<std::string_view> expected;
+            size_t                        begin = 0;
+            for (size_t pos; (pos = line.find(',', begin)) != std::string_view::npos; begin = pos + 1) {
+                expected.push_back(line.substr(begin, pos - begin));
+            }
+            if (begin < line.size()) {
+                expected.push_back(line.substr(begin));
+            }
+
+            auto range = fty::splitView(line, ",", fty::SplitOption::KeepEmpty | fty::SplitOption::NoTrim);
+            CHECK(std::vector<std::string_view>(range.begin(), range.end()) == expected);
+        }
+    }
+
+    SECTION("Sparse delimiters")
+    {
+        std::string line(1100, 'x');
+        for (size_t pos : {0, 63, 64, 200, 1000, 1099}) {
+            line[pos] = ',';
+        }
+        auto range = fty::splitView(line, ",", fty::SplitOption::KeepEmpty | fty::SplitOption::NoTrim);
+        std::vector<size_t> sizes;
+        for (auto part : range) {
+            sizes.push_back(part.size());
+        }
+        CHECK(sizes == std::vector<size_t>{0, 62, 0, 135, 799, 98});
+    }
+
+    SECTION("Long trim")
+    {
+        for (size_t pad : {0, 15, 16, 17, 64, 100, 300}) {
+            std::string spaces = std::string(pad, ' ') + std::string(pad, '\t');
+            CHECK(fty::trimmedView(spaces + "ex-parrot" + spaces) == "ex-parrot");
+            CHECK(fty::trimmedView(spaces + "x" + spaces) == "x");
+            CHECK(fty::trimmedView(spaces).empty());
+        }
+    }
+}
+
+TEST_CASE("Split throughput", "[.][benchmark]")
+{
+    auto run = [](const std::string& title, size_t fieldSize) {
+        std::string field(fieldSize, 'v');
+        std::string line;
+        while (line.size() < 64 * 1024 * 1024) {
+            line += field + std::to_string(line.size() % 997) + ",";
+        }
+
+        auto measure = [&](const char* name, auto&& func) {
+            auto   start  = std::chrono::steady_clock::now();
+            size_t fields = 0;
+            for (int i = 0; i < 5; ++i) {
+                fields += func();
+            }
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << title << ", " << name << ": " << 5.0 * double(line.size()) / elapsed.count() / 1e9 << " GB/s ("
+                      << fields / 5 << " fields)" << std::endl;
+        };
+
+        measure("string::find", [&]() {
+            size_t count = 0;
+            size_t begin = 0;
+            for (size_t pos; (pos = line.find(',', begin)) != std::string::npos; begin = pos + 1) {
+                ++count;
+            }
+            return count;
+        });
+
+        measure("splitView", [&]() {
+            size_t count = 0;
+            for ([[maybe_unused]] auto part : fty::splitView(line, ",", fty::SplitOption::KeepEmpty | fty::SplitOption::NoTrim)) {
+                ++count;
+            }
+            return count;
+        });
+
+        measure("splitView, trim", [&]() {
+            size_t count = 0;
+            for ([[maybe_unused]] auto part : fty::splitView(line, ",")) {
+                ++count;
+            }
+            return count;
+        });
+    };
+
+    run("Short fields", 4);
+    run("Long fields", 200);
+}
+
+TEST_CASE("Typed split throughput", "[.][benchmark]")
+{
+    std::vector<std::string> lines;
+    for (int i = 0; i < 1000000; ++i) {
+        lines.push_back("sensor" + std::to_string(i % 100) + ";" + std::to_string(i) + ";" + std::to_string(i * 0.25) + ";1");
+    }
+
+    auto measure = [&](const char* name, auto&& func) {
+        auto   start = std::chrono::steady_clock::now();
+        double sum   = 0;
+        for (const auto& line : lines) {
+            sum += func(line);
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << double(lines.size()) / elapsed.count() / 1e6 << " M lines/s (" << sum << ")" << std::endl;
+    };
+
+    measure("split<T...>", [](const std::string& line) {
+        auto [name, id, value, valid] = fty::split<std::string, int, double, bool>(line, ";");
+        return valid ? double(id) + value + double(name.size()) : 0;
+    });
+    measure("trySplit<T...>", [](const std::string& line) {
+        auto tuple = fty::trySplit<std::string_view, int, double, bool>(line, ";");
+        if (!tuple) {
+            return 0.;
+        }
+        auto [name, id, value, valid] = *tuple;
+        return valid ? double(id) + value + double(name.size()) : 0;
+    });
+}
+
+TEST_CASE("Split pattern throughput", "[.][benchmark]")
+{
+    std::string line;
+    while (line.size() < 4 * 1024 * 1024) {
+        line += "field " + std::to_string(line.size() % 997) + " ,; ";
+    }
+
+    for (const char* pattern : {",", "[,;]+", "\\s+"}) {
+        auto measure = [&](const char* name, auto&& func) {
+            auto   start  = std::chrono::steady_clock::now();
+            size_t fields = func().size();
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cout << pattern << ", " << name << ": " << double(line.size()) / elapsed.count() / 1e6 << " MB/s (" << fields
+                      << " fields)" << std::endl;
+        };
+
+        std::regex        re(pattern);
+        fty::SplitPattern compiled(pattern);
+        measure("std::regex", [&]() {
+            return fty::split(line, re);
+        });
+        measure("SplitPattern", [&]() {
+            return fty::split(line, compiled);
+        });
+    }
+}
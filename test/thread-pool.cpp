@@ -306,3 +306,52 @@ TEST_CASE("ThreadPool dynamic workers stop")
 
     std::cout << ">> Finished" << std::endl;
 }
+
+TEST_CASE("ThreadPool executor for queued slots")
+{
+    fty::ThreadPool pool(1);
+
+    fty::Event<int>  sig;
+    std::atomic<int> sum = 0;
+    std::thread::id  slotThread;
+
+    fty::Slot<int> slot(
+        [&](int val) {
+            slotThread = std::this_thread::get_id();
+            sum += val;
+        },
+        pool.executor());
+    sig.connect(slot);
+
+    sig(20);
+    sig(22);
+
+    pool.stop();
+
+    CHECK(sum == 42);
+    CHECK(slotThread != std::this_thread::get_id());
+}
+
+TEST_CASE("ThreadPool executor outlives the pool")
+{
+    fty::Event<int>  sig;
+    std::atomic<int> sum = 0;
+
+    std::unique_ptr<fty::Slot<int>> slot;
+    {
+        fty::ThreadPool pool(1);
+        slot = std::make_unique<fty::Slot<int>>(
+            [&](int val) {
+                sum += val;
+            },
+            pool.executor());
+        sig.connect(*slot);
+
+        sig(42);
+        pool.stop();
+    }
+
+    // Connection is still there, the job is dropped
+    sig(1);
+    CHECK(sum == 42);
+}
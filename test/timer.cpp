@@ -65,3 +65,35 @@ TEST_CASE("Timer")
         CHECK(count == 5);
     }
 }
+
+TEST_CASE("Timer statistics")
+{
+    using namespace std::literals::chrono_literals;
+
+    fty::Timer::enableStatistics();
+
+    auto fast = fty::Timer::singleShot(100ms, [&]() {});
+    fast.setLabel("fast");
+    auto slow = fty::Timer::singleShot(200ms, [&]() {
+        std::this_thread::sleep_for(50ms);
+    });
+    slow.setLabel("slow");
+    CHECK(fty::Timer::statistics().activeTimers == 2);
+
+    fast.finish.wait();
+    slow.finish.wait();
+
+    auto stats = fty::Timer::statistics();
+    CHECK(stats.activeTimers == 0);
+    CHECK(stats.lateness.count == 2);
+    CHECK(stats.execution.count == 2);
+    CHECK(stats.execution.max >= 50ms);
+    CHECK(stats.wakeupsPerSecond > 0);
+
+    auto slowest = fty::Timer::slowestCallbacks(1);
+    REQUIRE(slowest.size() == 1);
+    CHECK(slowest[0].label == "slow");
+    CHECK(slowest[0].calls == 1);
+
+    fty::Timer::enableStatistics(false);
+}